@@ -28,6 +28,15 @@ SOURCES += main.cpp \
     equationparser.cpp \
     widgetaddons.cpp \
     helpers.cpp \
+    grid.cpp \
+    kernels.cpp \
+    threadpool.cpp \
+    fft.cpp \
+    amr.cpp \
+    batch.cpp \
+    study.cpp \
+    decomposition.cpp \
+    clsolver.cpp \
     tutorial.cpp \
     lua-5.3.3/src/lapi.c \
     lua-5.3.3/src/lauxlib.c \
@@ -72,6 +81,16 @@ HEADERS += \
     equationparser.h \
     widgetaddons.h \
     helpers.h \
+    grid.h \
+    kernels.h \
+    stencil.h \
+    threadpool.h \
+    fft.h \
+    amr.h \
+    batch.h \
+    study.h \
+    decomposition.h \
+    clsolver.h \
     tutorial.h \
     lua-5.3.3/install/include/lauxlib.h \
     lua-5.3.3/install/include/lua.h \
@@ -108,6 +127,11 @@ HEADERS += \
 RESOURCES += \
     resources.qrc
 
-#QMAKE_LFLAGS += -framework OpenCL
+# the OpenCL backend (see clsolver.h), only with qmake CONFIG+=opencl: it needs an OpenCL loader to link against
+opencl {
+    DEFINES += QUTOSS_OPENCL
+    macx: LIBS += -framework OpenCL
+    else: LIBS += -lOpenCL
+}
 
 DISTFILES +=
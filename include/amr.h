@@ -0,0 +1,67 @@
+#ifndef AMR_H
+#define AMR_H
+
+#define AMR_RATIO 2                 // fine samples per coarse spacing: patches take AMR_RATIO^2 steps per coarse step
+#define AMR_BUFFER 3                // coarse samples of margin around the flagged ones, so that features stay inside
+#define AMR_MIN_PATCH 8             // smallest side of a patch, in coarse samples
+#define AMR_POTENTIAL_JUMP 4.0      // default: refine where V changes by more than this between neighbouring samples
+#define AMR_WAVE_JUMP 0.5           // default: or where ψ does, relative to the largest |ψ| on the grid
+#define AMR_REGRID_INTERVAL 10      // frames between regrids (the wavefunction moves, the flags move with it)
+#define AMR_ROWS_PER_TASK 4         // granularity of the parallel sweeps of a patch
+#define MULTIRATE_POTENTIAL 5.0     // default: the sweeps step for potentials up to this, the rest is split off
+
+#include "grid.h"
+#include "helpers.h"
+
+/* This file:
+ * - contains the block-structured refinement of the sweeps: a single level of rectangular patches on top of the grid
+ *   of Data (the coarse one), sampled AMR_RATIO times finer
+ *      - patches go wherever the potential or the wavefunction is steep: findRefinementRegions flags the samples,
+ *        pads them by AMR_BUFFER, and merges the padded flags into non-overlapping rectangles
+ *      - the potential of a patch is interpolated from the coarse one: the gain is in resolving the wavefunction
+ *        (evanescent tails, reflections) against barriers, which the coarse spacing smears out
+ * - a frame of the coarse grid is advanced first, then every patch sub-cycles through it (AMR_RATIO^2 fine steps
+ *   for each coarse one, the explicit solvers need dt ~ dR^2):
+ *      - unlike those of Grid, the ghost cells of a patch are written to: they hold the coarse solution interpolated
+ *        (bicubic, bilinear for V, in space, linear in time between the start and the end of the coarse frame)
+ *      - afterwards the patch is restricted back onto the coarse samples inside of it, conservatively: the fine
+ *        samples on top of the coarse ones are injected, scaled so that those keep the norm that the coarse sweeps
+ *        left in them (the patch and the coarse grid exchange probability through the coarse stencil only, so the
+ *        norm is conserved as well as by the plain sweeps). Full weighting would damp the phase oscillations of ψ
+ * */
+
+
+struct RefinedPatch
+{
+    Region coarse;   // coarse samples covered: fine sample (i, j) sits on coarse (xStart + i/AMR_RATIO, yStart + j/AMR_RATIO)
+    Grid fine;
+
+    // ghost cells of fine: plane index and position on the coarse grid, and the coarse solution there
+    // at the start and the end of the frame
+    vector<int> ghosts;
+    vector<double> ghostX, ghostY;
+    vector<double> reStart, imStart, reEnd, imEnd;
+};
+
+
+// flags samples where V jumps by more than potentialJump, or ψ by more than waveJump*max|ψ|, to one of their neighbours
+vector<Region> findRefinementRegions(const Grid& coarse, double potentialJump, double waveJump);
+
+// flags samples where V is above potential (for the multirate stepping of Data, no patches are built on them)
+vector<Region> findStiffRegions(const Grid& coarse, double potential);
+
+// a patch over region, the wavefunction and potential are interpolated from coarse, except where one of the old patches
+// already had fine samples (those are copied over, not to lose what they resolved)
+void initPatch(RefinedPatch& patch, const Grid& coarse, const Region& region, const vector<RefinedPatch>& old);
+
+// samples the coarse solution at the ghost cells of patch: into reStart/imStart, or reEnd/imEnd if end is set
+void sampleGhosts(RefinedPatch& patch, const Grid& coarse, bool end);
+
+// numSteps repetitions of stepSweeps (one fine time step), ghost cells are interpolated in time before each of them
+void advancePatch(RefinedPatch& patch, const vector<Sweep>& stepSweeps, int numSteps, double fineDR, int order);
+
+// the coarse samples strictly inside of the patch take the values of the fine samples on top of them (injection),
+// the patch is scaled so that their norm stays what the coarse sweeps made it
+void restrictPatch(RefinedPatch& patch, Grid& coarse);
+
+#endif // AMR_H
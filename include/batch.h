@@ -0,0 +1,62 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#define BATCH_BAND_ROWS 4   // rows per task of the wavefront of PacketBatch::advance, at least STENCIL_MAX_RADIUS
+#define BATCH_DEPTH 4       // sweeps that go through the wavefront together
+#define BATCH_MIN_COLUMNS 32   // samples of a row per task of the wavefront, at least (the bands are split along y)
+
+#include "grid.h"
+#include "helpers.h"
+
+/* This file:
+ * - contains PacketBatch: several wavefunctions (one per initial Packet) evolved over the same potential, i.e the
+ *   runs of a parameter study, without a Data per packet
+ *      - the packets are interleaved: all of those of a sample are contiguous (padded to BATCH_LANE_MULTIPLE), so the
+ *        batch kernels of kernels.h run their vectors across the packets, and read V once per sample for all of them
+ *      - a batch costs the same for any number of packets up to the next multiple of BATCH_LANE_MULTIPLE
+ *      - the row kernels are already vectorized (along y), so the gain over separate runs is in V, the row setup and
+ *        the partial vectors at the ends of the rows, not in the width of the vectors: the interleaved planes are also
+ *        BATCH_LANE_MULTIPLE times larger, so advance sweeps them as a wavefront (see there) to stay in cache
+ *      - same sweeps as Data (the Sweep lists of VERLET or PEFRL) and same kernels: a packet ends up with the values
+ *        that Data would compute for it, up to rounding (the AVX kernels of Data leave the last length % 4 samples of
+ *        a row to rowScalar, without fused multiply-adds, the batch kernels fuse every sample)
+ * - only the plain sweeps: no walls, absorbing layer, refinement or active region (every sample is swept)
+ * */
+
+
+class PacketBatch
+{
+public:
+    PacketBatch() {;}
+
+    // packets sampled on grid: its potential and coordinates are copied, its wavefunction is not used
+    PacketBatch(const Grid& grid, const vector<Packet>& packets, double dR, int order = 6);
+
+    int size() const { return int(packets.size());}
+    const Packet& getPacket(int b) const { return packets[b];}
+
+    // every sweep over every packet, the bands of rows (and columns of those) are split on the ThreadPool
+    void advance(const vector<Sweep>& sweeps);
+
+    double reCur(int b, int x, int y) const { return re[lane(x, y) + b];}
+    double imCur(int b, int x, int y) const { return im[lane(x, y) + b];}
+
+    // same as Data::getProbability, for packet b
+    double getProbability(int b, int x1, int x2, int y1, int y2) const;
+
+    // copies the wavefunction of packet b into the planes of out, which has the size of grid (i.e to draw it)
+    void extract(int b, Grid& out) const;
+
+private:
+    Grid grid;   // potential, coordinates and layout of the samples
+    vector<Packet> packets;
+    int lanes = 0;   // packets per sample, padded: the extra ones stay zero
+    double dR = 0;
+    int order = 6;
+
+    // packet b of sample (x, y) is at lane(x, y) + b
+    AlignedVector<double> re, im;
+    size_t lane(int x, int y) const { return size_t(grid.index(x, y))*lanes;}
+};
+
+#endif // BATCH_H
@@ -0,0 +1,75 @@
+#ifndef CLSOLVER_H
+#define CLSOLVER_H
+
+#define CLSOLVER_ROWS_PER_GROUP 16   // rows summed per work-group of the probability reduction
+
+#include <memory>
+#include "grid.h"
+#include "helpers.h"
+
+/* This file:
+ * - contains OpenCLSolver: the sweeps of VERLET and PEFRL, the colour mapping of Data::updateGrid and the probability
+ *   sums, run on an OpenCL device (through the bindings of cl.hpp, which only the .cpp includes)
+ *      - the planes (re, im and V, laid out like those of Grid, ghost cells included) live on the device: they are
+ *        uploaded when Data changes them itself, and only read back when something on the host needs the wavefunction
+ *      - a frame is only enqueued: the host waits on the device when it needs a result (a probability, the colours)
+ *      - the sweep kernel is computeNextSegment, one work-item per sample, with the weights of the row kernels: the
+ *        results are those of the scalar kernels (no contraction into fused multiply-adds), up to the libraries of
+ *        the device
+ *      - the probability of a rectangle is summed per row, then per work-group, and those partial sums are added on
+ *        the host in order: not the same order as Data::getProbability, so the last bits can differ
+ * - the device: the first GPU (of any platform) that has doubles, else any device that has them, CPU runtimes
+ *   (PoCL, the CPU runtimes of intel and AMD) included, so it also runs on machines without a GPU
+ *      - set the environment variable QUTOSS_OPENCL_DEVICE to part of a device's name to pick that one instead
+ * - only the plain sweeps: no walls, absorbing layer, refinement or multirate (Data uses the CPU for those)
+ * - only built with QUTOSS_OPENCL (qmake CONFIG+=opencl), without it the solver is never ready and says so
+ * */
+
+
+class OpenCLSolver
+{
+public:
+    OpenCLSolver();   // picks the device and builds the kernels, see isReady
+    ~OpenCLSolver();
+
+    OpenCLSolver(const OpenCLSolver&) = delete;
+    OpenCLSolver& operator=(const OpenCLSolver&) = delete;
+
+    // "all is well", or what went wrong (no device, a failed build, a failed call): nothing runs once it is not ready
+    bool isReady() const { return ready;}
+    const string& getStatus() const { return status;}
+    const string& getDeviceName() const { return deviceName;}
+
+    // copies the wavefunction and potential of grid to the device, the planes are reallocated if its layout changed
+    bool upload(const Grid& grid);
+
+    // copies the wavefunction back into grid (of the layout last uploaded), blocking
+    bool download(Grid& grid);
+
+    // every sweep over the whole grid, spacing dR and a laplacian of the given order, enqueued without waiting
+    bool advance(const vector<Sweep>& sweeps, double dR, int order);
+
+    // sum of |ψ|² over the samples [x1, x2] x [y1, y2] (inclusive, any order), not yet multiplied by dR^2
+    bool sumProbability(int x1, int x2, int y1, int y2, double& sum);
+
+    // the first loop of Data::updateGrid: for every sample (x, y), at x*sizeY + y, the value that is drawn
+    // (drawMode 'P': |ψ|², 'R': re, 'I': im) and its colour under cmap ('h', 'j' or 'c', between min and max),
+    // highlighted if preview is set (see Color::highlight)
+    bool colorSamples(char drawMode, char cmap, double min, double max, bool preview,
+                      vector<double>& values, vector<float>& colors);
+
+private:
+    struct Device;   // the objects of cl.hpp
+    unique_ptr<Device> device;
+
+    bool ready = false;
+    string status = "all is well";
+    string deviceName;
+
+    int nx = 0, ny = 0, stride = 0, origin = 0;   // layout of the uploaded grid, origin = Grid::index(0, 0)
+    size_t planeSize = 0;
+
+    bool fail(const string& what, int error);   // sets status, and ready to false
+};
+
+#endif // CLSOLVER_H
@@ -3,6 +3,14 @@
 
 #define MAX_NUM_PARTICLES 30
 #define TIME_LIMIT 100.0    // allotted per simulation
+#define ROWS_PER_PARCEL 4   // granularity of the parallel sweeps: grid rows per task handed to the thread pool
+#define TILE_ROWS 32        // temporal blocking: grid rows produced by each tile
+#define TILE_DEPTH 4        // temporal blocking: sweeps that a tile is advanced through before moving on to the next
+#define ACTIVE_THRESHOLD 1E-24     // |ψ|² below which a sample is left out of the active region (see updateActiveRegion)
+#define EIGEN_STATES 100            // default number of eigenstates that eigenQuantum expands the wavefunction in
+#define EIGEN_MAX_ITERATIONS 400    // lanczos gives up after this many (each one stores a vector of the grid's size)
+#define EIGEN_MAX_DEGREE 300        // of the chebyshev filter that lanczos runs on, see computeEigenStates
+#define EIGEN_TOLERANCE 1E-8        // residual of an eigenpair for it to count as converged (relative to the spectrum)
 
 #include <QVector>
 #include <QVector3D>
@@ -24,8 +32,16 @@
 #include <random>
 #include <list>
 #include <iomanip>
+#include <sstream>
+#include <numeric>
 #include "helpers.h"
 #include "equationparser.h"
+#include "threadpool.h"
+#include "fft.h"
+#include "amr.h"
+#include "batch.h"
+#include "decomposition.h"
+#include "clsolver.h"
 
 /* This file:
  * - contains necessary data and methods for simulations
@@ -68,7 +84,11 @@ public:
     unsigned getNetVerticesLength() { return (unsigned)netVertices.length();}
     unsigned getNetElementsLength() { return (unsigned)netElements.length();}
     unsigned getNumExistingTiles() { return tileNum;}
-    unsigned getSamplesPerSide() { return samplesPerSide;}
+    unsigned getSamplesX() { return samplesX;}
+    unsigned getSamplesY() { return samplesY;}
+    double getSideLengthX() { return sideLengthX;}
+    double getSideLengthY() { return sideLengthY;}
+    double getTimeStep() { return stepSize;}
     unsigned getNumParticles() { return numParticles;}
     double getSimulationTime() { return elapsedTime;}
     double getRemainingTime() { return TIME_LIMIT - elapsedTime;}
@@ -80,6 +100,7 @@ public:
     double getPacketAngle() { return initialPacket.angle;}
     double getPacketPrecision() { return initialPacket.precision;}
     QVector3D getPacketCenter() { return {float(initialPacket.xCen), float(initialPacket.yCen), 0.0};}   // in world coordinates
+    const Packet& getPacket() { return initialPacket;}
 
     // the calls exist for use with OpenGL buffers
     // gridVertices is altered by either 'initGridVertices' or 'updateGrid'
@@ -101,6 +122,77 @@ public:
     // 2) set by values from other widgets
     // lastly, note that for changes to appear on screen, signal must be emitted to glwidget to write to buffers
     void setSimSpeed(unsigned speed) { simSpeed = speed; }
+    void setFusedStepping(bool fused) { fusedStepping = fused; }   // see runSweepsFused
+    void setTemporalBlocking(bool blocking) { temporalBlocking = blocking; }   // see runSweepsBlocked
+
+    // the sweeps split the whole grid between the workers rather than the active region, so that every worker keeps
+    // the rows whose pages it first touched (on NUMA machines, those of its own socket) at the cost of the balance
+    // on by default when the workers are pinned (see ThreadPool)
+    void setStableOwnership(bool stable) { stableOwnership = stable; }
+    void setSinglePrecision(bool single) { singlePrecision = single; }   // see runSweepsSingle
+    void setStencilOrder(int order);   // of the laplacian used by every solver but the split-operator one: 2, 4, 6 or 8
+
+    // resizes the grid to samplesX by samplesY samples centered on the origin, sideLengthX wide (both counts are made
+    // odd, as simpson's rule needs it): samples stay square, so the length along y is sideLengthX*(samplesY - 1)/(samplesX - 1)
+    // the time step is derived from the new spacing, every buffer is reallocated, the potential is resampled and
+    // the simulation is reset, then domainChanged is emitted
+    void setDomain(int samplesX, int samplesY, double sideLengthX);
+    void setDomain(int samplesPerSide, double sideLength) { setDomain(samplesPerSide, samplesPerSide, sideLength);}
+    void setIntegrator(Integrator method) { integrator = method; }
+    // with tracking (the default), the sweeps skip the samples outside of the active region (see updateActiveRegion):
+    // the results agree with full sweeps to within ACTIVE_THRESHOLD, not bit for bit, as the small |ψ| out there is
+    // frozen rather than advanced, and the samples at the edge of the region read it
+    void setActiveRegionTracking(bool tracking) { activeRegionTracking = tracking; activeRegionValid = false;}
+
+    // samples with V >= threshold become hard walls (see updateWallMask), for the sweeps only:
+    // the other integrators still see them as a (high) potential
+    void setWallMasking(bool masking, double threshold = MAX_POTENTIAL)
+    {
+        wallMasking = masking;
+        wallPotential = threshold;
+        wallMaskValid = false;
+    }
+
+    // complex absorbing potential -iW along the edges, width in world units (0 to go back to reflecting walls):
+    // W rises quadratically from 0, width away from the edge, to strength at the edge
+    // the packets leave through it rather than bounce back, for the sweeps only
+    void setAbsorbingLayer(double width, double strength = DEFAULT_ABSORBING_STRENGTH);
+
+    // patches of AMR_RATIO times finer samples, wherever V jumps by more than potentialJump or ψ by more than waveJump
+    // (relative to its peak) between neighbouring samples, for the sweeps only (see amr.h)
+    // walls and absorbing layers are left to the coarse grid
+    void setRefinement(bool refine, double potentialJump = AMR_POTENTIAL_JUMP, double waveJump = AMR_WAVE_JUMP);
+    int getNumPatches() { return int(patches.size());}
+
+    // multirate stepping: the sweeps take steps that are stable for V up to potential, rather than MAX_POTENTIAL,
+    // and the rest of the potential (only in the stiff regions, where V > potential) is applied exactly around them
+    // for the sweeps only: fewer sweeps per frame, when the high potentials are few and the grid is coarse enough
+    // for them to matter (see runSweepsMultirate)
+    void setMultirate(bool enable, double potential = MULTIRATE_POTENTIAL);
+    int getNumStiffRegions() { return int(stiffRegions.size());}
+
+    // packets over the current potential, spacing and stencil order, evolved together (see batch.h)
+    // advanceBatch takes them through numFrames frames of advanceSimulation: simSpeed steps of VERLET, or of PEFRL
+    PacketBatch createBatch(const vector<Packet>& packets) { return PacketBatch(gridData, packets, dR, stencilOrder);}
+    void advanceBatch(PacketBatch& batch, int numFrames);
+
+    // the current state split into slabs of rows, each one advanced by a rank of its own (see decomposition.h)
+    // advanceDecomposition takes it through numFrames frames, as advanceBatch does, gatherDecomposition brings the
+    // wavefunction back into the grid (to draw it, or before anything else reads it)
+    unique_ptr<DomainDecomposition> createDecomposition(int numRanks)
+    {
+        fetchDeviceState();
+        return unique_ptr<DomainDecomposition>(new DomainDecomposition(gridData, dR, stencilOrder, numRanks));
+    }
+    void advanceDecomposition(DomainDecomposition& decomposition, int numFrames);
+    void gatherDecomposition(const DomainDecomposition& decomposition) { dropDeviceState(); eigenProjected = false; decomposition.gather(gridData);}
+
+    // OPENCL_BACKEND: the sweeps of VERLET and PEFRL, updateGrid's colours and getProbability run on an OpenCL device
+    // (see clsolver.h), where the wavefunction stays between frames, the environment variable QUTOSS_BACKEND=opencl
+    // starts out with it. Frames with walls, an absorbing layer, refinement or multirate still run on the CPU
+    // returns "all is well", or why there is no device: the CPU stays in charge then
+    string setComputeBackend(ComputeBackend backend);
+    ComputeBackend getComputeBackend() { return computeBackend;}
     void setSensitivity(int s) { jetMax = 1.0 - double(s)/100.0; } // s in range [0.0 , 0.9]
     string setEquation(const QString& s);
 
@@ -128,6 +220,10 @@ public:
     void setSpeed(double speed);
     void setAngle(double angleDeg);
     void setPrecision(double precision);
+
+    // for scripted runs (see study.h): the whole packet at once, through clipPacket, and confirmed
+    // unlike setCenter, the center is not moved onto a sample nor away from the edges, and nothing is drawn
+    void setPacket(const Packet& packet);
     void setArrow(const QVector3D& endPoint); // visualization for velocity
     void saveCurrentState() { initialPacketSaved = initialPacket;} // save snapshot of Packet that we can return to later
     void restoreSaved();
@@ -145,6 +241,10 @@ public:
     void confirmPacket();
     void observe(double precision, double timeLimit = TIME_LIMIT);  // sets the elapsed time to be high: don't want sim to run for much longer
 
+    // runs numSteps time steps in double then in single precision from the current state, prints how far apart they
+    // end up (the drift), then restores the state it found
+    void reportPrecisionDrift(int numSteps);
+
     // clears and reorders everything in the element buffer
     void updateTileOrder(bool preview = true);
 
@@ -154,6 +254,29 @@ public:
     void pefrlQuantum(double timeStep);
     void resetSimulation();
 
+    // strang splitting, e^(-iHdt) ~ e^(-iVdt/2) e^(-iTdt) e^(-iVdt/2), where the kinetic part is exact in the sine basis:
+    // unconditionally stable, so timeStep can be far larger than getTimeStep() (accuracy still goes down with dt^2)
+    void splitOperatorQuantum(double timeStep, int numSteps = 1);
+
+    // crank-nicolson, split into alternating directions (peaceman-rachford) so that it only takes banded solves:
+    // each half-step is implicit along one axis and explicit along the other, the potential is shared between the two
+    // unitary for any timeStep, and uses the same laplacian as the stencil solver (see setStencilOrder)
+    void adiQuantum(double timeStep, int numSteps = 1);
+
+    // the wavefunction is expanded in the lowest eigenstates of H for the current potential (once, with lanczos),
+    // after that every call is a phase rotation of the coefficients and a reconstruction: the cost does not depend on
+    // timeStep, so any time can be jumped to directly
+    //  - the expansion is redone whenever the potential or the wavefunction was changed by something else
+    //  - states above the ones computed are lost: the part of the norm that was kept is printed
+    void eigenQuantum(double timeStep);
+    void setNumEigenStates(int numStates) { numEigenStates = numStates; eigenValues.clear();}
+
+    // one step of any size: e^(-iHdt) = e^(-ibdt) sum_k (2 - δ_k0)(-i)^k J_k(adt) T_k((H - b)/a), where [b - a, b + a]
+    // holds the spectrum of H (from the potential and the stencil), the series is cut off once J_k is at round-off:
+    // about adt terms (each one is a stencil sweep of both R and I), rather than the 3dt/getTimeStep() sweeps of verlet
+    void chebyshevQuantum(double timeStep);
+    void fastForward(double time) { dropDeviceState(); chebyshevQuantum(time); elapsedTime += time; activeRegionValid = false;}
+
     // for the dual-simulation with classical particles
     // verlet can be used by itself, but we will call it (3x) as part of forest-ruth algorithm
     void verletClassical(double timeStep);
@@ -169,6 +292,7 @@ signals:
     void updateIndicatorBuffers();
     void updateParticleBuffers();
     void updateNetBuffers();
+    void domainChanged();   // all buffers were reallocated: GL buffers have to be as well
     void updateTileEbo();
 
 private:
@@ -183,11 +307,83 @@ private:
     int placementSpacing = 3;
     int resolution = 2;  // the number of squares we use on each side is times 2, any value > 2 is not supported atm.
     unsigned simSpeed = 1;
-    unsigned samplesPerSide;
+    bool fusedStepping = true;   // run all sweeps of a frame inside one parallel region
+    bool temporalBlocking = false;   // for grids that do not fit in cache, takes precedence over fusedStepping
+    bool stableOwnership = ThreadPool::global().isPinned();   // see setStableOwnership
+    AlignedVector<double> nextRe, nextIm;   // output planes of runSweepsBlocked, swapped with those of gridData
+    bool singlePrecision = false;   // sweeps on float copies of the hot planes, ignored by runSweepsBlocked
+    AlignedVector<float> reSingle, imSingle, VSingle;   // same layout as the planes of gridData
+    Integrator integrator = VERLET;
+    int stencilOrder = 6;
+
+    // the sweeps only go over sweepRegion: the whole grid, or the active region if it is tracked
+    Region sweepRegion;
+    Region activeRegion;
+    bool activeRegionTracking = true;
+    bool activeRegionValid = false;   // reset when something else writes to the wavefunction
+
+    // hard walls: the open samples of row x are openSpans[openSpanStart[x]] to openSpans[openSpanStart[x + 1] - 1]
+    bool wallMasking = false;
+    double wallPotential = MAX_POTENTIAL;
+    bool wallMaskValid = false;   // reset when the potential is changed, or something else writes to the wavefunction
+    vector<int> openSpanStart;
+    vector<Span> openSpans;
+
+    // absorbing layer: W(x, y) = absorbingX[x] + absorbingY[y], both zero outside of the layer
+    double absorbingWidth = 0;
+    double absorbingStrength = DEFAULT_ABSORBING_STRENGTH;
+    int absorbingSamples = 0;   // width of the layer in samples, 0 if there is none
+    vector<double> absorbingX, absorbingY;
+
+    // refinement: the patches are rebuilt every AMR_REGRID_INTERVAL frames
+    bool refinement = false;
+    double refinePotentialJump = AMR_POTENTIAL_JUMP, refineWaveJump = AMR_WAVE_JUMP;
+    vector<RefinedPatch> patches;
+    bool patchesValid = false;   // reset when the potential is changed, or something else writes to the wavefunction
+    int framesSinceRegrid = 0;
+
+    // multirate: the stiff regions, and V clipped to multiratePotential inside of them (the sweeps see this one)
+    // rebuilt along with the patches
+    bool multirate = false;
+    double multiratePotential = MULTIRATE_POTENTIAL;
+    vector<Region> stiffRegions;
+    AlignedVector<double> slowPotential;
+
+    // OpenCL: the device has the current wavefunction and potential (deviceCurrent), gridData has the current
+    // wavefunction (hostCurrent), at least one of them does
+    ComputeBackend computeBackend = CPU_BACKEND;
+    unique_ptr<OpenCLSolver> openCL;   // made on first use, kept when going back to the CPU
+    bool deviceCurrent = false, hostCurrent = true;
+    vector<double> deviceValues;   // output of OpenCLSolver::colorSamples
+    vector<float> deviceColors;
+
+    // for splitOperatorQuantum: the wavefunction is copied out of gridData (without the ghost cells) to be transformed
+    SinePlan sineX, sineY;
+    vector<cdouble> spectral;
+    vector<cdouble> kineticPhase;   // e^(-iTdt) of every sine mode, with the normalization of both transforms
+    double kineticPhaseStep = 0;    // the dt that kineticPhase was computed for
+
+    // for adiQuantum: same layout as spectral
+    vector<cdouble> adiWave, adiRhs;
+
+    // for eigenQuantum: the states are laid out like the planes of gridData (ghost cells included)
+    int numEigenStates = EIGEN_STATES;
+    vector<double> eigenValues;
+    vector<AlignedVector<double>> eigenStates;
+    vector<cdouble> eigenCoefficients;   // of the wavefunction at the time it was projected
+    double eigenTime = 0;                // time since then
+    bool eigenProjected = false;         // reset when something else writes to the wavefunction
+    AlignedVector<double> eigenPotential;   // the potential that eigenStates belong to
+
+    // for chebyshevQuantum: re/im planes of the last three terms of the recurrence, and of the sum
+    vector<AlignedVector<double>> chebyshevPlanes;
+    unsigned samplesX, samplesY;
+    double sideLengthX, sideLengthY;   // of the domain, in world units (the GL view spans the longer one)
     unsigned tileNum = 0;    // helps us keep track of where we are in tileVertices
     unsigned numParticles = 1;  // no longer makes any sense to have more than 1 particle (we only need one for classical analogy)
     double elapsedTime = 0;   // simulation world time (not done with QTime or std)
     double dR;
+    double stepSize;   // of a single time step of the explicit solvers, from stableTimeStep (see setDomain)
     double factor = 0.15;  // additional variable to control brushPrecision
     const double minPrecision = 0.5, maxPrecision = 25;    // if you change these values, it's important that you alter the appropriate QSlider as well
     double brushPrecision = 0.5, brushHeight = 1.0/24.0;   // precision from [0.5, 25] ; height from [2.04, -2.04]
@@ -207,7 +403,7 @@ private:
     QVector<GLuint> funcMeshElements;
     QVector<GLuint> particleElements;   // needed for drawing a circle
     QVector<GLuint> brushElements;      // uses indicator vertices
-    QVector<QVector<Point>> gridData;
+    Grid gridData;   // structure-of-arrays, see grid.h
     QVector<QVector<int>> simpsonCoeffs;  // for 2D simpsons rule
     Particle particle;
     QPoint anchorBlockID, stretchBlockID;  // raw outputs from find closest indices
@@ -265,6 +461,7 @@ private:
     QPoint findClosestIndicesFlat(const QVector3D& start, const QVector3D &direction, int spacing);
 
     // call with preview = true in any other case (won't be simulation-ready but changes are reflected)
+    void allocateGridBuffers();   // (re)sizes everything that depends on the number of samples, then initializes it
     void initGridData();
     void initGridVertices();
     void initTileVertexData();
@@ -305,17 +502,123 @@ private:
     QVector2D observePosition();
 
     // helpful function, needed in updateGrid
-    // index denotes element in gridData, i.e xIndex*samplesPerSide + yIndex
+    // index denotes element in gridData, i.e xIndex*samplesY + yIndex
     double getProbFromIndex(int index);
     double computeNext(Mode mode, int x, int y, double dT);
 
     void interpolateBilinear(char drawMode, char probsCmap, bool preview);
     void interpolateBicubic(char drawMode, char probsCmap, bool preview);
 
-    // not used: multithreading verletQuantum, not too useful
-    // id indicates which block (out of 'total' number of blocks)
+    // id indicates which block of rows (out of numParcels blocks)
+    // verletQuantumParcel is not used: the sweeps of a time step need barriers between them
     void verletQuantumParcel(double timeStep, int id, int numParcels);
     void updateGridParcel(Mode mode, double timeStep, int id, int numParcels);
+
+    // one sweep of mode over the whole grid, split into parcels and run on the thread pool
+    void sweepGrid(Mode mode, double timeStep);
+
+    // the sweeps making up numSteps consecutive velocity-verlet (or PEFRL) steps,
+    // with the last R sweep of each step merged into the first of the next one
+    vector<Sweep> verletSweeps(double timeStep, int numSteps);
+    vector<Sweep> pefrlSweeps(double timeStep, int numSteps);
+    vector<Sweep> integratorSweeps(double timeStep, int numSteps);   // those of the current integrator
+
+    // either calls sweepGrid for each of the sweeps, runSweepsFused (the default) or runSweepsBlocked
+    void runSweeps(const vector<Sweep>& sweeps);
+
+    // bounding box of the samples where |ψ|² > ACTIVE_THRESHOLD, grown by padding on every side:
+    // samples outside of it are negligible and stay that way for as long as it takes the stencil to cover padding
+    // (they are not swept: whatever |ψ|² below ACTIVE_THRESHOLD they hold stays frozen)
+    //  - only the previous region (grown by padding) has to be searched, everything else is still negligible
+    void updateActiveRegion(int padding);
+
+    // temporal blocking: the grid is cut into tiles of TILE_ROWS rows, each one is advanced through up to TILE_DEPTH
+    // sweeps in a local (cache-resident) buffer before moving on to the next, instead of streaming the whole grid
+    // through memory for every sweep
+    //  - tiles overlap: every sweep reads one stencil radius further out, so these rows are recomputed by neighbouring tiles
+    void runSweepsBlocked(const vector<Sweep>& sweeps);
+    void advanceTile(const Sweep* sweeps, int numSweeps, int tile);
+
+    // for splitOperatorQuantum: (re)makes the plans/phases if the grid or the time step changed
+    void setupSplitOperator(double timeStep);
+    void potentialPhase(double timeStep);   // spectral *= e^(-iVdt)
+
+    // for adiQuantum, along one line (row or column) of n samples, A being the 1-D hamiltonian with V/2:
+    // out = (1 - iAdt/2)*in, and line = (1 + iAdt/2)^-1 * line
+    // V is read every VStride elements (the lines themselves are contiguous)
+    void adiExplicitLine(const cdouble* in, cdouble* out, const double* V, int VStride, int n, double timeStep);
+    void adiImplicitLine(cdouble* line, const double* V, int VStride, int n, double timeStep);
+
+    // for eigenQuantum
+    void applyHamiltonian(const double* in, double* out);   // both laid out like the planes of gridData
+    void spectralBounds(double& lower, double& upper);      // of H: every eigenvalue is within [lower, upper]
+    void computeEigenStates();    // lanczos with full reorthogonalization, then ritz vectors of the converged pairs
+    void projectOntoEigenStates();
+
+    // runs all of the sweeps inside one parallel region of the thread pool, with a fixed block of rows per worker:
+    // there is no dispatching between sweeps, only a lightweight barrier
+    void runSweepsFused(const vector<Sweep>& sweeps);
+
+    // single precision: the rows of sweepRegion (and their halo) are rounded to float, swept, then written back
+    //  - twice the samples per SIMD register and half the memory traffic of the double sweeps
+    //  - everything outside of the sweeps (norms, energies, drawing) still reads the double planes
+    void runSweepsSingle(const vector<Sweep>& sweeps);
+
+    // samples the absorbing potential on the current grid
+    void updateAbsorbingProfiles();
+
+    // runSweeps (or runSweepsMultirate), then every patch sub-cycles through the same frameTime
+    // and is restricted back onto the grid, or runSweepsDevice if the frame runs on the OpenCL device
+    void runSweepsRefined(const vector<Sweep>& sweeps, double frameTime);
+    void regrid();   // new patches where the flags are now, the fine samples of the old ones are kept where they overlap
+
+    // splits V into the clipped potential and the excess over it (multiple time stepping, as in r-RESPA):
+    //  - the sweeps advance the kinetic part and the clipped potential, in steps only as short as those need
+    //  - the excess is diagonal: over each step it is the phase e^(-i(V - clipped)dt) of every sample of the stiff
+    //    regions, half before the sweeps and half after (strang splitting, so still second order and time reversible)
+    // there is no interface between the regions to couple, and the norm is kept
+    // the rotations keep consecutive steps from merging their sweeps: sweeps (frameTime in steps of stepSize) are run
+    // instead whenever they are fewer
+    void runSweepsMultirate(const vector<Sweep>& sweeps, double frameTime);
+    void rotateStiffRegions(double dT);   // ψ *= e^(-i(V - clipped)dT) over the stiff regions
+
+    // for the OpenCL backend:
+    //  - fetchDeviceState copies the wavefunction back into gridData if the device is ahead, for whatever reads it
+    //  - dropDeviceState does that as well, then has the device start over from gridData: for whatever writes to it
+    //  - runSweepsDevice uploads gridData if needed and enqueues the sweeps, false if the device failed
+    //    (the backend is back to the CPU then)
+    void fetchDeviceState();
+    void dropDeviceState();
+    bool deviceSweeps();   // the frame can run on the device
+    bool runSweepsDevice(const vector<Sweep>& sweeps);
+    void deviceFailed();   // reports the status of the device and falls back to CPU_BACKEND
+
+    // the part of absorbing potential that the sweeps do: after the component of mode was advanced by dT
+    // (over samples [yStart, yEnd) of row x), it is damped by e^(-W*dT) inside of the layer
+    // re and im point to sample (x, 0) of planes laid out like those of gridData
+    template<typename T> void absorbRow(Mode mode, int x, int yStart, int yEnd, T* re, T* im, double dT) const;
+
+    // finds the spans of every row that are outside of the walls, and zeroes the wavefunction inside of them:
+    // the walls are then dirichlet boundaries like the ghost cells, the sweeps skip them and they stay zero
+    void updateWallMask();
+
+    // calls f(start, end) for every part of [yStart, yEnd) of row x that is outside of the walls
+    // (the whole of it, if there are none)
+    template<typename F> void forOpenSpans(int x, int yStart, int yEnd, F f) const
+    {
+        if (!wallMasking)
+        {
+            f(yStart, yEnd);
+            return;
+        }
+
+        for (int k = openSpanStart[x]; k < openSpanStart[x + 1]; ++k)
+        {
+            int start = max(yStart, openSpans[k].start), end = min(yEnd, openSpans[k].end);
+            if (start < end)
+                f(start, end);
+        }
+    }
 };
 
 #endif // DATA_H
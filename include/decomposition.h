@@ -0,0 +1,111 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#define DECOMPOSITION_MAX_RANKS 64      // slabs of a DomainDecomposition
+#define DECOMPOSITION_MAX_SWEEPS 1024   // per command sent to the ranks: longer lists are sent in pieces
+
+#include <atomic>
+#include <thread>
+#include "grid.h"
+#include "helpers.h"
+#include "kernels.h"
+
+/* This file:
+ * - contains DomainDecomposition: the grid split into slabs of whole rows, each one advanced by a rank of its own
+ *   (a process, forked from this one, on linux and macOS; a thread elsewhere), for grids that are too large for the
+ *   time budget of a single process
+ *      - the slabs live in memory shared with the ranks: rank r owns slab r and is the first to write to it, so on NUMA
+ *        machines its pages are on the node that it runs on
+ *      - each slab carries GRID_HALO ghost rows on either side, the ones between two slabs are refreshed from the
+ *        neighbour after every sweep (the stencil radius, order/2 rows, of the component that was just swept)
+ *      - halo exchange overlaps with the interior: a rank sweeps its boundary rows first, publishes them (a counter
+ *        per rank), sweeps the rest, and only then waits for its neighbours' boundary rows. Ranks synchronize with
+ *        their two neighbours only, never all together
+ *      - rows are swept in a different order, but every row gets the same operations: the results are exactly those
+ *        of Data, sweeping the whole grid
+ * - the wavefunction stays in the slabs: gather copies it back into a Grid only when asked (to draw a frame, or for a
+ *   checkpoint), getProbability is reduced by the ranks themselves
+ * - only the plain sweeps: no walls, absorbing layer, refinement or active region (every sample is swept)
+ * - ranks only run the row kernels on their slab and spin on the shared counters: nothing in them allocates or locks,
+ *   which is what makes forking a process that has other threads safe
+ * */
+
+
+class DomainDecomposition
+{
+public:
+    // the samples of grid (wavefunction and potential) split between numRanks ranks, which are started right away
+    // there are fewer ranks if the slabs would be thinner than GRID_HALO rows, grid is only read until this returns
+    DomainDecomposition(const Grid& grid, double dR, int order, int numRanks);
+    ~DomainDecomposition();   // stops the ranks
+
+    DomainDecomposition(const DomainDecomposition&) = delete;
+    DomainDecomposition& operator=(const DomainDecomposition&) = delete;
+
+    int size() const { return numRanks;}
+    bool usesProcesses() const { return !processes.empty();}
+    int getSlabStart(int rank) const { return slabStart[rank];}   // first row of the grid in slab rank
+
+    // every sweep over every slab, blocking until all of the ranks are done
+    void advance(const vector<Sweep>& sweeps);
+
+    // same as Data::getProbability: each rank sums its own rows, the partial sums are added in the order of the ranks
+    double getProbability(int x1, int x2, int y1, int y2);
+
+    // copies the wavefunction of every slab into out, which has the size of the grid
+    void gather(Grid& out) const;
+
+private:
+    enum Command { ADVANCE, PROBABILITY, STOP};
+
+    // a cache line of its own, as each one is spun on by other ranks
+    struct alignas(GRID_ALIGNMENT) Counter
+    {
+        atomic<long> value;
+    };
+
+    // at the start of the shared memory, the slabs follow it
+    struct Control
+    {
+        Counter generation;   // commands sent so far, that is what idle ranks wait on
+        Counter completed;    // commands finished, numRanks per command
+        Command command;
+        int numSweeps;
+        Sweep sweeps[DECOMPOSITION_MAX_SWEEPS];
+        int x1, x2, y1, y2;   // of PROBABILITY, inclusive
+        double partial[DECOMPOSITION_MAX_RANKS];
+        Counter published[DECOMPOSITION_MAX_RANKS];   // sweeps whose boundary rows rank r has finished, overall
+    };
+
+    int numRanks = 0;
+    int nx = 0, ny = 0, stride = 0, rowOffset = 0;
+    double dR = 0;
+    int radius = 3;
+    double coeffs[STENCIL_MAX_RADIUS + 1];
+    RowKernel kernel = nullptr;   // resolved before the ranks start (see rowKernels)
+
+    int slabStart[DECOMPOSITION_MAX_RANKS + 1];   // slab r holds the rows [slabStart[r], slabStart[r + 1]) of the grid
+    size_t slabOffset[DECOMPOSITION_MAX_RANKS];   // of the re plane of slab r in the shared memory, im and V follow it
+    size_t planeSize[DECOMPOSITION_MAX_RANKS];
+
+    char* shared = nullptr;
+    size_t sharedSize = 0;
+    Control* control = nullptr;
+    long commandsSent = 0;
+
+    const Grid* source = nullptr;   // only while the ranks copy their slabs in
+    vector<int> processes;
+    vector<thread> threads;
+
+    double* slabPlane(int rank, int plane) const
+    {
+        return reinterpret_cast<double*>(shared + slabOffset[rank]) + plane*planeSize[rank];
+    }
+    size_t localIndex(int x, int y) const { return size_t(x + GRID_HALO)*stride + y + rowOffset;}   // x within the slab
+
+    void send(Command command);   // and waits for every rank to finish it
+    void rankLoop(int rank, bool forked);   // forked: in a process of its own
+    void rankSweep(int rank, const Sweep& sweep, long count);   // count: sweeps done by the rank after this one
+};
+
+#endif // DECOMPOSITION_H
@@ -27,7 +27,7 @@ public:
     ~EquationParser();
     float evaluateEquation(float x, float y);
     void setEquation(string s) { standardized = standardize(s);  data = standardized.c_str(); }
-    string errorCheck(const QVector<QVector<Point>>& gridData);
+    string errorCheck(const Grid& gridData);
 
 private:
     string standardize(string raw);
@@ -0,0 +1,85 @@
+#ifndef FFT_H
+#define FFT_H
+
+#define FFT_MAX_RADIX 13       // larger prime factors make the plan fall back on bluestein's algorithm
+#define FFT_LINES_PER_TASK 4   // granularity of the 2-D transforms: lines per task handed to the thread pool
+
+#include <vector>
+#include <complex>
+#include <memory>
+
+using namespace std;
+
+typedef complex<double> cdouble;
+
+/* This file:
+ * - contains FFTPlan, the 1-D discrete fourier transform for any length
+ *      - iterative and in-place: mixed-radix cooley-tukey (radix 4, 2, 3, 5, ... 13) on the digit-reversed input
+ *      - lengths with a larger prime factor go through bluestein's algorithm (a power of 2 convolution)
+ *      - twiddles and permutations are computed once, when the plan is made
+ *      - unnormalized in both directions: inverse(forward(x)) == n*x
+ * - contains SinePlan, the type-I discrete sine transform (DST-I) done with an FFT of length 2(n + 1)
+ *      - its basis functions vanish right outside of the n samples, same as the wavefunction at the ghost cells of Grid
+ *      - it is its own inverse, up to a factor of (n + 1)/2
+ * - contains the 2-D versions, which transform all rows then all columns in parallel on the ThreadPool
+ * - plans are read-only once made, so they can be shared between threads
+ * */
+
+
+// std::complex's operator* takes care of inf/nan (a library call for every product), none of which we can have here
+inline cdouble multiply(const cdouble& a, const cdouble& b)
+{
+    return cdouble(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+}
+
+
+class FFTPlan
+{
+public:
+    FFTPlan() {;}
+    explicit FFTPlan(int n);
+
+    int size() const { return n;}
+    void forward(cdouble* data) const;
+    void inverse(cdouble* data) const;
+
+private:
+    int n = 0;
+    vector<int> radices;         // in the order the passes are done
+    vector<int> permutation;     // where every input sample goes before the first pass
+    vector<cdouble> twiddles;    // exp(-2πij/n)
+    vector<cdouble> passTwiddles;   // the ones used by each pass, contiguous in the order that the pass goes through them
+
+    // bluestein: x -> chirp*(convolution of chirp*x with conj(chirp)), the convolution is done through FFTs
+    bool bluestein = false;
+    vector<cdouble> chirp;         // exp(-πij²/n)
+    vector<cdouble> chirpFilter;   // FFT of conj(chirp), wrapped around and divided by the convolution length
+    shared_ptr<FFTPlan> convolution;
+
+    void radixTransform(cdouble* data) const;
+    void bluesteinTransform(cdouble* data) const;
+};
+
+
+class SinePlan
+{
+public:
+    SinePlan() {;}
+    explicit SinePlan(int n) : n(n), extended(2*(n + 1)) {;}
+
+    int size() const { return n;}
+
+    // y[k] = sum_j x[j]*sin(π(j + 1)(k + 1)/(n + 1))
+    void transform(cdouble* data) const;
+
+private:
+    int n = 0;
+    FFTPlan extended;   // odd extension of the samples, with the zeroes at both ends
+};
+
+
+// data holds planX.size() rows of planY.size() samples each, contiguous (x, y indexed like Grid, without the ghost cells)
+void fft2D(const FFTPlan& planX, const FFTPlan& planY, cdouble* data, bool inverse = false);
+void sineTransform2D(const SinePlan& planX, const SinePlan& planY, cdouble* data);
+
+#endif // FFT_H
@@ -49,6 +49,7 @@ public slots:
     // from buttons
     void observe();
     void resetSimulation();
+    void setDomain(int samplesPerSide, double sideLength);   // see Data::setDomain, the simulation is reset and paused
     void toggleBrush();
     void toggleDrawClassical() { drawClassicalParticle = !drawClassicalParticle;
                                  update();}
@@ -80,6 +81,7 @@ public slots:
     void updateNetBuffers();
     void updateMeshBuffers();
     void updateTileEbo();
+    void reallocateGridBuffers();   // after simData.setDomain
 
     // everytime timeout occurs we check to see if tutorial stage (applies for 1 & 2) is completed
     void tutTimer1TO();
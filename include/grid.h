@@ -0,0 +1,191 @@
+#ifndef GRID_H
+#define GRID_H
+
+#define GRID_ALIGNMENT 64   // in bytes: one cache line, also wide enough for the largest SIMD registers
+#define GRID_HALO 4         // ghost cells on each side: the radius of the widest stencil (STENCIL_MAX_RADIUS, 8th order)
+#define GRID_MMAP_BYTES (1 << 20)   // blocks at least this large get pages of their own (linux, see AlignedAllocator)
+
+#include <vector>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include "threadpool.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+/* This file:
+ * - contains Grid, the storage for everything that lives on the simulation samples
+ *      - laid out as a structure-of-arrays: each quantity is its own contiguous plane
+ *      - the planes that the stencil streams every sub-step (re, im, V) are cache-line aligned,
+ *        everything else (previous values, preview potential, refVal, ...) is kept in separate cold arrays
+ * - sample (x, y) lives at index(x, y) within every plane, rows are contiguous so y is the unit-stride direction
+ *   (the same order that the old QVector<QVector<Point>> was indexed in)
+ * - every plane carries a halo of GRID_HALO ghost cells around the samples, which is never written to:
+ *      - the zeroes there are the infinite potential walls at the edges of the domain
+ *      - kernels can therefore read any neighbour within GRID_HALO of a sample without checking bounds
+ * - the hot planes are first written by the workers of the ThreadPool that sweep them (see allocateOwned): on NUMA
+ *   machines, each block of rows ends up in the memory of the socket that streams it
+ * */
+
+
+// bare-bones allocator so that std::vector hands out aligned storage
+// (posix_memalign / _aligned_malloc are not portable between the platforms we ship for)
+template<typename T, size_t Alignment = GRID_ALIGNMENT>
+struct AlignedAllocator
+{
+    typedef T value_type;
+    template<typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() {;}
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {;}
+
+    T* allocate(size_t n)
+    {
+#ifdef __linux__
+        // large blocks straight from the kernel: malloc may hand back pages that an earlier block already touched
+        // (from whichever thread), fresh ones are only placed on a NUMA node once they are first written to
+        if (n*sizeof(T) >= GRID_MMAP_BYTES)
+        {
+            void* pages = mmap(NULL, n*sizeof(T), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pages == MAP_FAILED)
+                throw bad_alloc();
+            return static_cast<T*>(pages);
+        }
+#endif
+
+        // over-allocate, and stash the pointer returned by malloc right before the aligned block
+        void* raw = malloc(n*sizeof(T) + Alignment + sizeof(void*));
+        if (raw == NULL)
+            throw bad_alloc();
+
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+        uintptr_t aligned = (start + Alignment - 1) & ~uintptr_t(Alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+#ifdef __linux__
+        if (n*sizeof(T) >= GRID_MMAP_BYTES)
+        {
+            munmap(p, n*sizeof(T));
+            return;
+        }
+#endif
+        if (p != NULL)
+            free(reinterpret_cast<void**>(p)[-1]);
+    }
+
+    // elements without a value are left uninitialized rather than zeroed: resize(n) does not touch the pages,
+    // so that allocateOwned can leave that to the threads that use them
+    template<typename U> void construct(U* p) { ::new(static_cast<void*>(p)) U;}
+    template<typename U, typename... Args> void construct(U* p, Args&&... args)
+    {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template<typename T, typename U, size_t A>
+inline bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return true; }
+template<typename T, typename U, size_t A>
+inline bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return false; }
+
+template<typename T> using AlignedVector = vector<T, AlignedAllocator<T>>;
+
+
+// plane becomes numRows rows of rowLength elements, all zero, each row written first by the worker of the ThreadPool
+// that owns it: the rows between the halo ones are split by ThreadPool::ownedRange (as the sweeps split them),
+// the halo rows go to the first and the last worker
+// with first-touch placement (the default policy of linux), every block of rows sits on its worker's NUMA node
+template<typename T>
+void allocateOwned(AlignedVector<T>& plane, int numRows, size_t rowLength, int halo = GRID_HALO)
+{
+    AlignedVector<T>().swap(plane);   // new pages, not those of the old plane
+    plane.resize(size_t(numRows)*rowLength);
+
+    ThreadPool& pool = ThreadPool::global();
+    pool.runRegion([&](int worker, int numWorkers)
+    {
+        int start, end;
+        pool.ownedRange(worker, numRows - 2*halo, start, end);
+        start = (worker == 0) ? 0 : start + halo;
+        end = (worker == numWorkers - 1) ? numRows : end + halo;
+        fill(plane.begin() + size_t(start)*rowLength, plane.begin() + size_t(end)*rowLength, T(0));
+    });
+}
+
+
+class Grid
+{
+public:
+    Grid() {;}
+    Grid(int sizeX, int sizeY) { resize(sizeX, sizeY); }
+
+    // all planes are reallocated and zeroed, ghost cells included
+    void resize(int sizeX, int sizeY);
+
+    int sizeX() const { return nx;}
+    int sizeY() const { return ny;}
+    int getStride() const { return stride;}
+    int index(int x, int y) const { return (x + GRID_HALO)*stride + y + rowOffset;}   // valid for -GRID_HALO <= x, y < size + GRID_HALO
+
+    // hot planes: read/written by every sweep of the solver
+    double& reCur(int x, int y) { return reData[index(x, y)];}
+    double& imCur(int x, int y) { return imData[index(x, y)];}
+    double& V(int x, int y) { return VData[index(x, y)];}
+    double reCur(int x, int y) const { return reData[index(x, y)];}
+    double imCur(int x, int y) const { return imData[index(x, y)];}
+    double V(int x, int y) const { return VData[index(x, y)];}
+
+    // cold data: touched when (re)initializing, previewing, or drawing
+    double& reBefore(int x, int y) { return reBeforeData[index(x, y)];}
+    double& imBefore(int x, int y) { return imBeforeData[index(x, y)];}
+    double& VPreview(int x, int y) { return VPreviewData[index(x, y)];}
+    double VPreview(int x, int y) const { return VPreviewData[index(x, y)];}
+    char& covered(int x, int y) { return coveredData[index(x, y)];}     // deprecated: see Data::findRectangle
+
+    // be warned: this value is not guaranteed to be up to date (to save us time)
+    // the intention is to store the value that is drawn here: probability density, or re/im (see Data::updateGrid)
+    double& refVal(int x, int y) { return refValData[index(x, y)];}
+
+    // world coordinates of each sample only depend on one of the indices
+    double xCoord(int x) const { return xCoords[x];}
+    double yCoord(int y) const { return yCoords[y];}
+    void setXCoord(int x, double world) { xCoords[x] = world;}
+    void setYCoord(int y, double world) { yCoords[y] = world;}
+
+    // raw planes, for the kernels: (x, y) is at plane[index(x, y)], ghost cells included
+    double* rePlane() { return reData.data();}
+    double* imPlane() { return imData.data();}
+    double* VPlane() { return VData.data();}
+    const double* rePlane() const { return reData.data();}
+    const double* imPlane() const { return imData.data();}
+    const double* VPlane() const { return VData.data();}
+
+    // number of elements in every plane, ghost cells included
+    size_t planeSize() const { return reData.size();}
+
+    // exchanges the re/im planes with ones of the same layout, for solvers that write their results out-of-place
+    void swapWavePlanes(AlignedVector<double>& re, AlignedVector<double>& im) { reData.swap(re); imData.swap(im);}
+    void swapPotentialPlane(AlignedVector<double>& V) { VData.swap(V);}
+
+private:
+    int nx = 0, ny = 0;
+    int stride = 0;      // row length, including ghost cells and padding: keeps every row aligned
+    int rowOffset = 0;   // index of y = 0 within a row, rounded up from GRID_HALO so that samples start aligned
+
+    AlignedVector<double> reData, imData, VData;
+    vector<double> reBeforeData, imBeforeData, VPreviewData, refValData;
+    vector<char> coveredData;
+    vector<double> xCoords, yCoords;
+};
+
+#endif // GRID_H
@@ -1,10 +1,11 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
-// the number of samples vs. time step must carefully be defined for stability of the algorithm
-// to maintain stability, an increase in samples of factor k requires a decrease in time step of factor k
-#define NUM_SAMPLES 39601 // ~199^2  //30625  // ~175^2
-#define TIME_STEP 0.001
+// the domain can be changed at run time (Data::setDomain), these are what it starts with
+// the time step is not a setting: it follows from the stability bound of the explicit solvers (see stableTimeStep)
+#define DEFAULT_SAMPLES_PER_SIDE 199
+#define DEFAULT_SIDE_LENGTH 15.0
+#define STABILITY_FRACTION 0.55   // of the largest stable time step that is used, gives 0.001 for the default domain
 #define DIRAC_DELTA_RADIUS 0.05
 #define EPSILON  1E-8       // used when comparing doubles, and for adding to division by zero issues
 #define VERTEX_SIZE 6
@@ -14,9 +15,9 @@
 #define RAD_TO_DEG 57.2958
 #define CIRCLE_SIDES  50      // for graphics, the number of sides that we use to approximate a circle
 #define CIRCLE_SIDES_HD  500    // just cause the brush tends to be a lot larger as a circle
-#define SIDE_LENGTH 15.0
 #define MAX_POTENTIAL 30  // the algorithm is stable for about 50 or 60, but lower limits help with accuracy
 #define MAX_SPEED 6.5  // initial packet speed
+#define DEFAULT_ABSORBING_STRENGTH 20.0   // peak of the absorbing potential, at the edge of the domain (see Data::setAbsorbingLayer)
 #define MS_PER_FRAME 16.6667
 
 #include <stdio.h>
@@ -46,6 +47,9 @@
 #include <cmath>
 #include "math.h"
 #include "ae/ae.h"
+#include "grid.h"
+#include "kernels.h"
+#include "fft.h"
 
 using namespace std;
 
@@ -55,7 +59,7 @@ using namespace std;
  *          - functions for calculating probability density of quantum Packet(s) given
  *          - the real and imaginary parts of the wave function are calculated as well
  *      - conversions between different coordinates used throughout the program
- * - definitions for structs used here and in other files
+ * - definitions for structs used here and in other files (the simulation grid itself is in grid.h)
  * - ColorMapper class, useful for converting colors
  * */
 
@@ -63,22 +67,6 @@ using namespace std;
 typedef complex<double> cdouble;
 typedef complex<double> cdouble;
 
-// data to gl_vertex_buffer is transferred from an array of these structs
-struct Point
-{
-    double x, y;
-    double reBefore, reCur;
-    double imBefore, imCur;   // saved data, might be helpful
-    double V = 0, VPreview = 0;
-    bool covered = false;     // deprecated: was for optimizing the number of drawn potential tiles
-
-    // be warned: this value is not guaranteed to be up to date (to save us time)
-    // this is a convenience member, use as storage space if you need to save this value
-    // the intention is to store probability density here
-    double refVal = 0;
-};
-
-
 // deprecated:
 // the 3-D potential blocks that we draw to visualize barriers
 // values can be converted to world coordinates using conversion functions defined in this file
@@ -157,18 +145,100 @@ private:
 
 enum Mode { R, I, R_RK, I_RK};
 
+// how Data::advanceSimulation moves the wavefunction forward:
+// - VERLET and PEFRL are explicit (sweeps of the stencil), bound by the stability limit on the time step
+// - SPLIT_OPERATOR is spectral and unconditionally stable, it takes one step per frame (see Data::splitOperatorQuantum)
+// - ADI is implicit (crank-nicolson, one banded solve per row and per column), also unconditionally stable
+// - EIGEN expands the wavefunction in eigenstates of the hamiltonian once, then only rotates their phases
+//   (see Data::eigenQuantum, only makes sense for a potential that does not change)
+// - CHEBYSHEV expands e^(-iHdt) in chebyshev polynomials of H, exact to round-off for any dt (see Data::chebyshevQuantum)
+enum Integrator { VERLET, PEFRL, SPLIT_OPERATOR, ADI, EIGEN, CHEBYSHEV};
+
+// where VERLET and PEFRL run: the row kernels on the ThreadPool, or an OpenCL device (see clsolver.h)
+enum ComputeBackend { CPU_BACKEND, OPENCL_BACKEND};
+
+// one sweep of the solver: the component given by mode is advanced by timeStep over the whole grid
+// time steps are built out of sequences of these (i.e R, I, R for velocity-verlet)
+struct Sweep
+{
+    Mode mode;
+    double timeStep;
+};
+
+// block of samples [xStart, xEnd) x [yStart, yEnd), i.e the part of the grid that the sweeps are restricted to
+struct Region
+{
+    int xStart, xEnd;
+    int yStart, yEnd;
+
+    bool empty() const { return xStart >= xEnd || yStart >= yEnd;}
+};
+
+// samples [start, end) of a row
+struct Span
+{
+    int start, end;
+};
+
+// appends a sweep to the list, merging it into the last one if it is for the same component
+// (first-same-as-last: R(a) followed by R(b) is exactly R(a + b), as I does not change in between)
+void appendSweep(vector<Sweep>& sweeps, Mode mode, double timeStep);
+
+// speed and precision within the limits that Data::setSpeed and Data::setPrecision hold them to (the center is kept)
+Packet clipPacket(Packet packet);
+
 // for advancing the simulation (using explicit pseudo-verlet method)
 cdouble computeInitial(double x, double y, const Packet& packet);
-double computeNext(Mode mode, int x, int y, double dR, double dT, const QVector<QVector<Point>>& dataGrid);
+double computeNext(Mode mode, int x, int y, double dR, double dT, const Grid& grid);
+
+// straight-line version of computeNext over the samples [yStart, yEnd] of row x, updates grid in place:
+// boundary conditions come from the ghost cells of grid, so there are no branches in the loop
+// runs on the vectorized kernels from kernels.h, order is that of one of the stencils of stencil.h (2, 4, 6 or 8)
+void computeNextRow(Mode mode, int x, int yStart, int yEnd, double dR, double dT, Grid& grid, int order = 6);
+
+// same as computeNextRow, on raw planes laid out like the ones of Grid (i.e local copies of some of its rows):
+// re, im and V point at the first sample of the segment
+void computeNextSegment(Mode mode, double* re, double* im, const double* V, int length, int stride,
+                        double dR, double dT, int order = 6);
+
+// single precision version of computeNextSegment: the weights are computed in double then rounded once
+void computeNextSegment(Mode mode, float* re, float* im, const float* V, int length, int stride,
+                        double dR, double dT, int order = 6);
+
+// the time step that the explicit solvers (VERLET and PEFRL) use on a grid of spacing dR: STABILITY_FRACTION of the
+// largest stable one, for the stencil of that order and potentials up to MAX_POTENTIAL, rounded down to 2 digits
+// (an increase in samples of factor k requires a decrease in time step of factor k)
+double stableTimeStep(double dR, int order = 6);
+
+// upper bound on the eigenvalues of H on a grid of spacing dR, where the potential stays below maxPotential:
+// the explicit solvers are stable for dt < 2/stiffness
+double stiffness(double dR, int order = 6, double maxPotential = MAX_POTENTIAL);
+
+// coefficients of the 2-D laplacian (before dividing by dR^2), indexed by distance from the center, up to
+// STENCIL_MAX_RADIUS (zero past the radius of the stencil), order is 2, 4, 6 or 8
+// (the center one counts for both directions: it is twice that of the 1-D laplacian)
+const double* laplacianCoefficients(int order);
+
+// solves A*x = b in place (b becomes x), where A is a complex banded matrix with radius diagonals on each side:
+// A(i, i + k) is bands[i*(2*radius + 1) + radius + k], bands is overwritten
+// gaussian elimination without pivoting: meant for the diagonally dominant systems of implicit time-stepping
+void solveBanded(cdouble* bands, cdouble* b, int n, int radius);
+
+// eigenvalues/vectors of a real symmetric tridiagonal n x n matrix (implicit QL):
+// diagonal becomes the eigenvalues in ascending order, offDiagonal[i] is (i, i + 1) and is destroyed,
+// vectors is set to n x n with eigenvector k in column k (vectors[row*n + k])
+void tridiagonalEigen(vector<double>& diagonal, vector<double>& offDiagonal, vector<double>& vectors);
+
+// bessel functions of the first kind J_k(x) for k = 0, 1, ..., up to the first k > x where they drop below tolerance
+// (miller's backward recurrence, normalized with J_0 + 2*sum J_2k = 1): fine for any x >= 0, even in the thousands
+vector<double> besselSeries(double x, double tolerance);
 
 // this would have been (slightly) faster had it been a method of Data,
 // but this makes more programming sense as a more general computations function :
 // takes the fast-fourier transform of a 2-D array (or image), stores by reference
+// any size works, the transforms themselves are in fft.h
 template<typename T> void fftImage(const QVector<QVector<T>>& in, QVector<QVector<T>>& out);
 
-// important: as of now (and possibly forever), only works with powers of 2
-template<typename T> QVector<T> fftHelper(const QVector<T>& in, int start, int stepSize, char mode);
-
 
 // CONVERSIONS:
 
@@ -176,6 +246,10 @@ template<typename T> QVector<T> fftHelper(const QVector<T>& in, int start, int s
 // - index coordinates are vertex indices
 // - GL coordinates are openGL coordinates
 // - screen coordinates are viewport coordinates in pixels, depends on widget size
+// the world side length that the conversions map to [-1, 1] in GL coordinates, set along with the domain of Data
+double worldSideLength();
+void setWorldSideLength(double sideLength);
+
 double GLToWorld(double screenCoord);
 
 QVector3D GLToWorld(const QVector3D& glCoord);
@@ -184,7 +258,7 @@ double worldToGL(double worldCoord);
 QVector3D worldToGL(const QVector3D& worldCoord);
 
 double indexToGL(int index, int samplesPerSide);
-double indexToWorld(int index, double dR);
+double indexToWorld(int index, double dR, double axisLength);
 double indexToPotential(int z);
 double potentialToGL(double potential);
 double potentialToWorld(double potential);
@@ -221,8 +295,8 @@ template<typename T> int binarySearch(const vector<T>& info, T target);
 
 // define a pixel as the square bounded by 4 vertices :
 // then scaling = 2 means splitting each pixel into 4, scaling = 3 is splitting into 16, etc...
-// right now this function only deals with squares, so numOriginal needs to be a perfect square!
-int numVerticesAfterScaling(int numOriginal, int scaling);
+// numOriginal is the number of vertices along one side, the grid need not be square
+int verticesAfterScaling(int numOriginal, int scaling);
 double clipPotential(double potential);
 
 // both of the below functions return 3D points (as opengl is 3D) but z is always set to 0
@@ -0,0 +1,75 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#define BATCH_LANE_MULTIPLE 8   // packets per sample of a batch are padded to this: whole AVX-512 (or 2 AVX2) registers
+
+#include "stencil.h"
+
+/* This file:
+ * - contains the row kernels that the solver sweeps the grid with: they advance R (or I) over one segment of a row
+ *      - one instantiation per order of stencil.h (2, 4, 6 and 8), the loops over the stencil are unrolled
+ * - has hand-vectorized AVX2 (4 samples per instruction) and AVX-512 (8 samples per instruction) versions,
+ *   twice that for the float versions,
+ *   the best one that the CPU supports is selected once at startup (CPUID), with a scalar fallback
+ *      - set the environment variable QUTOSS_KERNELS to "scalar", "avx2" or "avx512" to cap the choice (for comparisons)
+ * - kernels rely on the ghost cells of Grid: neighbours within the stencil radius are always readable
+ * - the batch kernels do the same for several wavefunctions over one potential (see batch.h): the packets of a sample
+ *   are contiguous, so the vectors run across the batch, and V and the stencil offsets are loaded once per sample
+ *      - each packet goes through the same operations as with the row kernels (the results only differ where those
+ *        leave the last few samples of a segment to the scalar path, which has no fused multiply-adds)
+ * */
+
+
+// everything a kernel needs to update one row segment:
+// cur[y] += weights[0]*other[y] + sum_k weights[k]*(sum of the 4 neighbours of other[y] at distance k) + potentialWeight*V[y]*other[y]
+// weights already contain dT, the sign of the mode (R or I) and the 1/dR^2 of the laplacian
+// T is double, or float for the single-precision mode (twice as many samples per instruction)
+template<typename T> struct RowArgsT
+{
+    T* cur;                 // component being advanced, pointing at the first sample of the segment
+    const T* other;         // component that the laplacian is taken of, same position
+    const T* V;             // potential, same position
+    int length;             // number of samples in the segment
+    int stride;             // distance between vertically adjacent samples (Grid::getStride)
+    T weights[STENCIL_MAX_RADIUS + 1];   // indexed by distance from the center sample, up to the stencil radius
+    T potentialWeight;
+};
+
+typedef RowArgsT<double> RowArgs;
+typedef RowArgsT<float> RowArgsF;
+typedef void (*RowKernel)(const RowArgs& args);
+typedef void (*RowKernelF)(const RowArgsF& args);
+
+// same as RowArgs, for lanes wavefunctions interleaved sample by sample: packet b of sample y is at cur[y*lanes + b]
+struct BatchArgs
+{
+    double* cur;            // component being advanced, pointing at packet 0 of the first sample of the segment
+    const double* other;    // component that the laplacian is taken of, same position
+    const double* V;        // potential, one value per sample, shared by the packets
+    int length;             // number of samples in the segment
+    int lanes;              // packets per sample, a multiple of BATCH_LANE_MULTIPLE
+    int stride;             // distance between vertically adjacent samples: lanes*Grid::getStride
+    double weights[STENCIL_MAX_RADIUS + 1];
+    double potentialWeight;
+};
+
+typedef void (*BatchKernel)(const BatchArgs& args);
+
+// indexed by stencil radius (order/2), entry 0 is unused
+struct RowKernels
+{
+    RowKernel byRadius[STENCIL_MAX_RADIUS + 1];
+    RowKernelF byRadiusF[STENCIL_MAX_RADIUS + 1];
+    BatchKernel batchByRadius[STENCIL_MAX_RADIUS + 1];
+    const char* name;   // "scalar", "avx2" or "avx512"
+};
+
+// resolved on first call, after that it is just a reference to a static
+const RowKernels& rowKernels();
+
+// order is 2, 4, 6 or 8
+inline RowKernel rowKernel(int order) { return rowKernels().byRadius[order/2];}
+inline RowKernelF rowKernelF(int order) { return rowKernels().byRadiusF[order/2];}
+inline BatchKernel batchKernel(int order) { return rowKernels().batchByRadius[order/2];}
+
+#endif // KERNELS_H
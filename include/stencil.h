@@ -0,0 +1,73 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#define STENCIL_MAX_RADIUS 4   // of the widest stencil (8th order): Grid keeps that many ghost cells
+
+/* This file:
+ * - contains the family of central-difference laplacians used by every solver, as templates on the order (2, 4, 6, 8)
+ *      - the coefficients are constexpr, so the loops over them unroll and the products fold at compile time
+ *      - the 2-D stencil is the 1-D one applied along both axes: same weights, except for twice the center
+ * - Stencil<Order, T>::laplacian is the reference (scalar) version, the row kernels of kernels.h are instantiated
+ *   on the same orders, with weights taken from here
+ * - another order is one more specialization of LaplacianCoefficients, and one more instantiation of the kernels
+ * */
+
+
+// weights of the 2-D laplacian (before dividing by dR^2), indexed by distance from the center
+template<int Order> struct LaplacianCoefficients;
+
+template<> struct LaplacianCoefficients<2>
+{
+    static constexpr double at(int k) { return k == 0 ? -4.0 : k == 1 ? 1.0 : 0.0;}
+};
+
+template<> struct LaplacianCoefficients<4>
+{
+    static constexpr double at(int k) { return k == 0 ? -5.0 : k == 1 ? 4.0/3.0 : k == 2 ? -1.0/12.0 : 0.0;}
+};
+
+template<> struct LaplacianCoefficients<6>
+{
+    static constexpr double at(int k)
+    {
+        return k == 0 ? -49.0/9.0 : k == 1 ? 3.0/2.0 : k == 2 ? -3.0/20.0 : k == 3 ? 1.0/90.0 : 0.0;
+    }
+};
+
+template<> struct LaplacianCoefficients<8>
+{
+    static constexpr double at(int k)
+    {
+        return k == 0 ? -205.0/36.0 : k == 1 ? 8.0/5.0 : k == 2 ? -1.0/5.0 : k == 3 ? 8.0/315.0 :
+               k == 4 ? -1.0/560.0 : 0.0;
+    }
+};
+
+
+template<int Order, typename T = double> struct Stencil
+{
+    static constexpr int order = Order;
+    static constexpr int radius = Order/2;
+    static_assert(radius <= STENCIL_MAX_RADIUS, "stencil wider than the ghost cells of Grid");
+
+    static constexpr T coefficient(int k) { return T(LaplacianCoefficients<Order>::at(k));}
+
+    // laplacian (times dR^2) at p, a sample of a plane laid out like the ones of Grid
+    static T laplacian(const T* p, int stride) { return Ring<radius>::sum(p, stride);}
+
+private:
+    // rings of the 4 samples at distance K, outermost first: the recursion is resolved at compile time
+    template<int K, int Dummy = 0> struct Ring
+    {
+        static T sum(const T* p, int s)
+        {
+            return coefficient(K)*((p[-K] + p[K]) + (p[-K*s] + p[K*s])) + Ring<K - 1>::sum(p, s);
+        }
+    };
+    template<int Dummy> struct Ring<0, Dummy>
+    {
+        static T sum(const T* p, int) { return coefficient(0)*p[0];}
+    };
+};
+
+#endif // STENCIL_H
@@ -0,0 +1,88 @@
+#ifndef STUDY_H
+#define STUDY_H
+
+#define STUDY_BATCH_SIZE 16   // packets per PacketBatch in runStudy, a multiple of BATCH_LANE_MULTIPLE
+#define STUDY_FRAMES 100      // default length of a run, in frames of advanceSimulation
+
+#include <limits>
+#include <functional>
+#include <ostream>
+#include "helpers.h"
+
+/* This file:
+ * - contains parameter studies: many headless simulations, one per combination of packet settings and potential,
+ *   reduced to a few scalars each (what the GUI would show for them at the end of the run)
+ *      - studyGrid spans the cartesian product of lists of values, parseValueList reads those from text
+ *      - runStudy builds one Data per equation and runs every point that uses it, the results come back in the order
+ *        of the points, writeStudyTable writes them as CSV
+ * - the runs are not spread over threads themselves: every sweep already is (on the ThreadPool, which serializes
+ *   its callers anyway), so one run at a time uses all of the cores
+ * - batched (the default): the points of an equation go through PacketBatch, STUDY_BATCH_SIZE at a time
+ *      - only for VERLET and PEFRL without an absorbing layer (what PacketBatch supports), anything else is run
+ *        point by point through advanceSimulation
+ *      - same values as the separate runs, up to the rounding of the kernels (see kernels.h)
+ * - on OPENCL_BACKEND, the points run one by one on the device (through Data, see clsolver.h)
+ * - with ranks > 1, the points run one by one, each grid split between that many ranks (see decomposition.h), for
+ *   grids too large for a single process: same conditions as batching, the probabilities are reduced by the ranks
+ *   and the wavefunction is never gathered
+ * - the driver on the command line is in main.cpp (qutoss --study --help)
+ * */
+
+
+struct StudyPoint
+{
+    Packet packet;
+    string equation;   // of the potential, as for Data::setEquation
+};
+
+
+struct StudySettings
+{
+    // domain, as for Data::setDomain
+    int samplesX = DEFAULT_SAMPLES_PER_SIDE, samplesY = DEFAULT_SAMPLES_PER_SIDE;
+    double sideLengthX = DEFAULT_SIDE_LENGTH;
+
+    int numFrames = STUDY_FRAMES;
+    unsigned simSpeed = 1;   // time steps per frame
+    Integrator integrator = VERLET;
+    int stencilOrder = 6;
+    double absorbingWidth = 0;   // see Data::setAbsorbingLayer, 0 for reflecting walls
+    bool batched = true;
+    ComputeBackend backend = CPU_BACKEND;   // see Data::setComputeBackend, runs are never batched on OPENCL_BACKEND
+    int ranks = 1;   // > 1: every run is advanced by a DomainDecomposition of that many ranks (only on CPU_BACKEND)
+
+    // netted probability: the samples inside of this rectangle (world coordinates), the whole domain by default
+    double netXStart = -numeric_limits<double>::max(), netXEnd = numeric_limits<double>::max();
+    double netYStart = -numeric_limits<double>::max(), netYEnd = numeric_limits<double>::max();
+
+    // transmission: the probability at x >= transmissionX
+    double transmissionX = 0;
+};
+
+
+struct StudyResult
+{
+    StudyPoint point;   // with the packet as it was run, i.e after clipPacket
+    double nettedProbability = 0;
+    double norm = 0;
+    double transmission = 0;
+    string error;   // from Data::setEquation, the run was skipped if it is not empty
+};
+
+
+// every combination of the values given, in that order of nesting (the last list varies the fastest)
+vector<StudyPoint> studyGrid(const vector<string>& equations, const vector<double>& xCens, const vector<double>& yCens,
+                             const vector<double>& angles, const vector<double>& speeds, const vector<double>& precisions);
+
+// "a,b,c" or "start:end:step" (end included, if it is hit within rounding), appended to values
+// returns what is wrong with text, or an empty string
+string parseValueList(const string& text, vector<double>& values);
+
+// progress, if given, is called after each run (or batch) with the number of points done so far
+vector<StudyResult> runStudy(const vector<StudyPoint>& points, const StudySettings& settings,
+                             const function<void(int)>& progress = nullptr);
+
+// one line per result, after a header, the equations are quoted
+void writeStudyTable(ostream& out, const vector<StudyResult>& results);
+
+#endif // STUDY_H
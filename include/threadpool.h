@@ -0,0 +1,104 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+/* This file:
+ * - contains ThreadPool, a set of persistent worker threads used by the quantum solver
+ *      - workers are created once and sleep between jobs (after spinning briefly, as sweeps come in quick succession)
+ *      - each job is a range of independent tasks (i.e row blocks of the grid), dealt out to per-worker deques:
+ *        a worker that runs out of tasks steals from the back of the others' deques
+ *      - parallelFor only returns once every task is done, so consecutive calls are separated by a barrier
+ * - the thread calling parallelFor works on the tasks as well, it counts as one of the workers
+ * - alternatively, runRegion runs one function on all workers at once: the workers then decide their share of the work
+ *   themselves, and synchronize with sync() (a spinning barrier, much cheaper than waking up threads for every phase)
+ * - for NUMA machines, the workers can be pinned to cores: a worker then always runs on the same socket, as does the
+ *   memory that it first touched (see allocateOwned in grid.h)
+ * */
+
+
+// sense-reversing barrier: waiting threads spin (and yield, in case there are more threads than cores)
+class SpinBarrier
+{
+public:
+    explicit SpinBarrier(int count = 1) : count(count), waiting(0), phase(0) {;}
+    void reset(int newCount) { count = newCount; waiting.store(0);}
+    void wait();
+
+private:
+    int count;
+    atomic<int> waiting;
+    atomic<unsigned> phase;
+};
+
+class ThreadPool
+{
+public:
+    // numThreads <= 0 means one per hardware thread (can be overridden with the QUTOSS_THREADS environment variable)
+    // pin puts worker i on the i-th core the process may run on (linux only, also set by QUTOSS_PIN_THREADS=1):
+    // the calling thread, worker 0, is left alone as it belongs to the application
+    explicit ThreadPool(int numThreads = 0, bool pin = false);
+    ~ThreadPool();
+
+    // the pool shared by all simulations
+    static ThreadPool& global();
+
+    int size() const { return int(queues.size());}
+    bool isPinned() const { return pinned;}
+
+    // the share of [0, numTasks) that parallelFor deals to worker before any stealing (and that runRegion bodies take,
+    // when they split their work evenly): contiguous, and the same for every call with the same numTasks
+    void ownedRange(int worker, int numTasks, int& start, int& end) const
+    {
+        start = int((long long)numTasks*worker/size());
+        end = int((long long)numTasks*(worker + 1)/size());
+    }
+
+    // runs task(i) for every i in [0, numTasks), blocking until all of them have finished
+    // not reentrant: tasks must not call parallelFor themselves
+    void parallelFor(int numTasks, const function<void(int)>& task);
+
+    // runs body(worker, size()) once on every worker concurrently, blocking until all of them have returned
+    // inside body, every worker must call sync() the same number of times
+    void runRegion(const function<void(int, int)>& body);
+    void sync() { regionBarrier.wait();}
+
+private:
+    struct TaskQueue
+    {
+        mutex lock;
+        deque<int> tasks;
+    };
+
+    vector<thread> threads;
+    vector<unique_ptr<TaskQueue>> queues;   // queues[0] belongs to the calling thread
+
+    mutex jobLock;       // for sleeping/waking up workers
+    condition_variable wake, finished;
+    mutex callerLock;    // only one parallelFor at a time
+    const function<void(int)>* job = nullptr;
+    const function<void(int, int)>* region = nullptr;   // set while runRegion is active
+    SpinBarrier regionBarrier;
+    atomic<unsigned long> generation;   // bumped for every job, that is what workers wait on
+    atomic<int> remaining;
+    bool stopping = false;
+    bool pinned = false;
+
+    void workerLoop(int id);
+    void finishTask();
+
+    // pops own tasks first, then steals: returns when no task could be found anywhere
+    void runTasks(int id);
+    bool popTask(int id, int& task);
+};
+
+#endif // THREADPOOL_H
@@ -43,6 +43,9 @@ class Window : public QWidget //, public QLayout
 public:
     explicit Window(QWidget *parent = 0);
 
+    // samples and side length of the simulated domain (qutoss --samples n --length length), see Data::setDomain
+    void setDomain(int samplesPerSide, double sideLength) { simulation->setDomain(samplesPerSide, sideLength);}
+
 signals:
 
 
@@ -0,0 +1,324 @@
+#include "amr.h"
+#include "threadpool.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// bilinear, at position (X, Y) of the grid (in samples): the ghost cells take part, so it goes to zero past the edges
+// used for the potential, as it never overshoots (the time step relies on |V| <= MAX_POTENTIAL)
+static double interpolateLinear(const Grid& grid, const double* plane, double X, double Y)
+{
+    int x = min(max(int(floor(X)), -GRID_HALO), grid.sizeX() + GRID_HALO - 2);
+    int y = min(max(int(floor(Y)), -GRID_HALO), grid.sizeY() + GRID_HALO - 2);
+    double fx = min(max(X - x, 0.0), 1.0), fy = min(max(Y - y, 0.0), 1.0);
+
+    return (1.0 - fx)*((1.0 - fy)*plane[grid.index(x, y)] + fy*plane[grid.index(x, y + 1)]) +
+           fx*((1.0 - fy)*plane[grid.index(x + 1, y)] + fy*plane[grid.index(x + 1, y + 1)]);
+}
+
+
+// bicubic (lagrange, on 4x4 samples), for the wavefunction: bilinear interpolation is off by ~(k*dR)^2/8 at the middle
+// of a cell, which is enough for waves to partly reflect off the edges of a patch
+static double interpolateCubic(const Grid& grid, const double* plane, double X, double Y)
+{
+    int x = min(max(int(floor(X)), 1 - GRID_HALO), grid.sizeX() + GRID_HALO - 3);
+    int y = min(max(int(floor(Y)), 1 - GRID_HALO), grid.sizeY() + GRID_HALO - 3);
+
+    auto weights = [](double t, double* w)
+    {
+        w[0] = -t*(t - 1.0)*(t - 2.0)/6.0;
+        w[1] = (t + 1.0)*(t - 1.0)*(t - 2.0)/2.0;
+        w[2] = -(t + 1.0)*t*(t - 2.0)/2.0;
+        w[3] = (t + 1.0)*t*(t - 1.0)/6.0;
+    };
+    double wx[4], wy[4];
+    weights(X - x, wx);
+    weights(Y - y, wy);
+
+    double sum = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const double* row = plane + grid.index(x - 1 + i, y - 1);
+        sum += wx[i]*(wy[0]*row[0] + wy[1]*row[1] + wy[2]*row[2] + wy[3]*row[3]);
+    }
+    return sum;
+}
+
+
+// rectangles that overlap or touch (the ghost cells of one would lie inside of the other)
+static bool adjacent(const Region& a, const Region& b)
+{
+    return a.xStart <= b.xEnd && b.xStart <= a.xEnd && a.yStart <= b.yEnd && b.yStart <= a.yEnd;
+}
+
+
+// pads the flags (one per sample, x major) by AMR_BUFFER along x then along y, and merges them into rectangles
+// that do not touch
+static vector<Region> clusterFlags(vector<char>& flagged, int nx, int ny)
+{
+    ThreadPool& pool = ThreadPool::global();
+    vector<char> padded(size_t(nx)*ny, 0);
+    pool.parallelFor(nx, [&](int x)
+    {
+        for (int i = max(0, x - AMR_BUFFER); i <= min(nx - 1, x + AMR_BUFFER); ++i)
+            for (int y = 0; y < ny; ++y)
+                padded[size_t(x)*ny + y] |= flagged[size_t(i)*ny + y];
+    });
+    pool.parallelFor(nx, [&](int x)
+    {
+        char* row = &flagged[size_t(x)*ny];
+        const char* source = &padded[size_t(x)*ny];
+        for (int y = 0; y < ny; ++y)
+        {
+            row[y] = 0;
+            for (int j = max(0, y - AMR_BUFFER); j <= min(ny - 1, y + AMR_BUFFER) && !row[y]; ++j)
+                row[y] = source[j];
+        }
+    });
+
+    // bounding boxes of the connected groups of flags
+    vector<Region> boxes;
+    vector<QPoint> toVisit;
+    for (int x = 0; x < nx; ++x)
+        for (int y = 0; y < ny; ++y)
+        {
+            if (!flagged[size_t(x)*ny + y])
+                continue;
+
+            Region box = { x, x + 1, y, y + 1 };
+            flagged[size_t(x)*ny + y] = 0;
+            toVisit.assign(1, QPoint(x, y));
+            while (!toVisit.empty())
+            {
+                QPoint cur = toVisit.back();
+                toVisit.pop_back();
+                box = { min(box.xStart, cur.x()), max(box.xEnd, cur.x() + 1),
+                        min(box.yStart, cur.y()), max(box.yEnd, cur.y() + 1) };
+
+                const int moves[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+                for (int m = 0; m < 4; ++m)
+                {
+                    int i = cur.x() + moves[m][0], j = cur.y() + moves[m][1];
+                    if (i >= 0 && j >= 0 && i < nx && j < ny && flagged[size_t(i)*ny + j])
+                    {
+                        flagged[size_t(i)*ny + j] = 0;
+                        toVisit.push_back(QPoint(i, j));
+                    }
+                }
+            }
+            boxes.push_back(box);
+        }
+
+    // grow the small ones, then merge until no two boxes touch (growing can make them touch, merging can't shrink them)
+    for (Region& box : boxes)
+    {
+        auto grow = [](int& start, int& end, int n)
+        {
+            int size = min(AMR_MIN_PATCH, n);
+            if (end - start >= size)
+                return;
+            start = max(0, start - (size - (end - start) + 1)/2);
+            end = min(n, start + size);
+            start = end - size;
+        };
+        grow(box.xStart, box.xEnd, nx);
+        grow(box.yStart, box.yEnd, ny);
+    }
+
+    for (bool merged = true; merged;)
+    {
+        merged = false;
+        for (size_t i = 0; i < boxes.size() && !merged; ++i)
+            for (size_t j = i + 1; j < boxes.size() && !merged; ++j)
+            {
+                if (!adjacent(boxes[i], boxes[j]))
+                    continue;
+
+                boxes[i] = { min(boxes[i].xStart, boxes[j].xStart), max(boxes[i].xEnd, boxes[j].xEnd),
+                             min(boxes[i].yStart, boxes[j].yStart), max(boxes[i].yEnd, boxes[j].yEnd) };
+                boxes.erase(boxes.begin() + j);
+                merged = true;
+            }
+    }
+
+    return boxes;
+}
+
+
+vector<Region> findRefinementRegions(const Grid& coarse, double potentialJump, double waveJump)
+{
+    const int nx = coarse.sizeX(), ny = coarse.sizeY();
+    ThreadPool& pool = ThreadPool::global();
+
+    double maxSquared = 0;
+    for (int x = 0; x < nx; ++x)
+        for (int y = 0; y < ny; ++y)
+            maxSquared = max(maxSquared, coarse.reCur(x, y)*coarse.reCur(x, y) + coarse.imCur(x, y)*coarse.imCur(x, y));
+    const double waveSquared = waveJump*waveJump*maxSquared;
+
+    vector<char> flagged(size_t(nx)*ny, 0);
+    pool.parallelFor(nx, [&](int x)
+    {
+        for (int y = 0; y < ny; ++y)
+        {
+            const int moves[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+            for (int m = 0; m < 4 && !flagged[size_t(x)*ny + y]; ++m)
+            {
+                int i = x + moves[m][0], j = y + moves[m][1];
+                if (i < 0 || j < 0 || i >= nx || j >= ny)
+                    continue;
+
+                double dRe = coarse.reCur(i, j) - coarse.reCur(x, y), dIm = coarse.imCur(i, j) - coarse.imCur(x, y);
+                if (fabs(coarse.V(i, j) - coarse.V(x, y)) > potentialJump ||
+                    (maxSquared > 0 && dRe*dRe + dIm*dIm > waveSquared))
+                    flagged[size_t(x)*ny + y] = 1;
+            }
+        }
+    });
+
+    return clusterFlags(flagged, nx, ny);
+}
+
+
+vector<Region> findStiffRegions(const Grid& coarse, double potential)
+{
+    const int nx = coarse.sizeX(), ny = coarse.sizeY();
+    vector<char> flagged(size_t(nx)*ny, 0);
+    ThreadPool::global().parallelFor(nx, [&](int x)
+    {
+        for (int y = 0; y < ny; ++y)
+            flagged[size_t(x)*ny + y] = coarse.V(x, y) > potential;
+    });
+
+    return clusterFlags(flagged, nx, ny);
+}
+
+
+void initPatch(RefinedPatch& patch, const Grid& coarse, const Region& region, const vector<RefinedPatch>& old)
+{
+    const int r = AMR_RATIO;
+    const int nx = (region.xEnd - region.xStart - 1)*r + 1;
+    const int ny = (region.yEnd - region.yStart - 1)*r + 1;
+    patch.coarse = region;
+    patch.fine.resize(nx, ny);
+    Grid& fine = patch.fine;
+
+    for (int i = 0; i < nx; ++i)
+        for (int j = 0; j < ny; ++j)
+        {
+            double X = region.xStart + double(i)/r, Y = region.yStart + double(j)/r;
+            fine.V(i, j) = interpolateLinear(coarse, coarse.VPlane(), X, Y);
+            fine.reCur(i, j) = interpolateCubic(coarse, coarse.rePlane(), X, Y);
+            fine.imCur(i, j) = interpolateCubic(coarse, coarse.imPlane(), X, Y);
+
+            // both patches are on the same fine lattice
+            for (const RefinedPatch& p : old)
+            {
+                int oi = (region.xStart - p.coarse.xStart)*r + i, oj = (region.yStart - p.coarse.yStart)*r + j;
+                if (oi >= 0 && oj >= 0 && oi < p.fine.sizeX() && oj < p.fine.sizeY())
+                {
+                    fine.reCur(i, j) = p.fine.reCur(oi, oj);
+                    fine.imCur(i, j) = p.fine.imCur(oi, oj);
+                    break;
+                }
+            }
+        }
+
+    patch.ghosts.clear();
+    patch.ghostX.clear();
+    patch.ghostY.clear();
+    for (int i = -GRID_HALO; i < nx + GRID_HALO; ++i)
+        for (int j = -GRID_HALO; j < ny + GRID_HALO; ++j)
+        {
+            if (i >= 0 && j >= 0 && i < nx && j < ny)
+                continue;
+            patch.ghosts.push_back(fine.index(i, j));
+            patch.ghostX.push_back(region.xStart + double(i)/r);
+            patch.ghostY.push_back(region.yStart + double(j)/r);
+        }
+
+    patch.reStart.assign(patch.ghosts.size(), 0.0);
+    patch.imStart.assign(patch.ghosts.size(), 0.0);
+    patch.reEnd.assign(patch.ghosts.size(), 0.0);
+    patch.imEnd.assign(patch.ghosts.size(), 0.0);
+}
+
+
+void sampleGhosts(RefinedPatch& patch, const Grid& coarse, bool end)
+{
+    vector<double>& re = end ? patch.reEnd : patch.reStart;
+    vector<double>& im = end ? patch.imEnd : patch.imStart;
+    for (size_t k = 0; k < patch.ghosts.size(); ++k)
+    {
+        re[k] = interpolateCubic(coarse, coarse.rePlane(), patch.ghostX[k], patch.ghostY[k]);
+        im[k] = interpolateCubic(coarse, coarse.imPlane(), patch.ghostX[k], patch.ghostY[k]);
+    }
+}
+
+
+void advancePatch(RefinedPatch& patch, const vector<Sweep>& stepSweeps, int numSteps, double fineDR, int order)
+{
+    Grid& fine = patch.fine;
+    const int nx = fine.sizeX(), ny = fine.sizeY();
+    const int numTasks = (nx + AMR_ROWS_PER_TASK - 1)/AMR_ROWS_PER_TASK;
+    ThreadPool& pool = ThreadPool::global();
+
+    for (int step = 0; step < numSteps; ++step)
+    {
+        // the coarse solution at the middle of this step
+        double theta = (step + 0.5)/numSteps;
+        for (size_t k = 0; k < patch.ghosts.size(); ++k)
+        {
+            fine.rePlane()[patch.ghosts[k]] = (1.0 - theta)*patch.reStart[k] + theta*patch.reEnd[k];
+            fine.imPlane()[patch.ghosts[k]] = (1.0 - theta)*patch.imStart[k] + theta*patch.imEnd[k];
+        }
+
+        for (const Sweep& sweep : stepSweeps)
+            pool.parallelFor(numTasks, [&](int task)
+            {
+                int end = min(nx, (task + 1)*AMR_ROWS_PER_TASK);
+                for (int x = task*AMR_ROWS_PER_TASK; x < end; ++x)
+                    computeNextRow(sweep.mode, x, 0, ny - 1, fineDR, sweep.timeStep, fine, order);
+            });
+    }
+}
+
+
+void restrictPatch(RefinedPatch& patch, Grid& coarse)
+{
+    const int r = AMR_RATIO;
+    Grid& fine = patch.fine;
+    const Region& region = patch.coarse;
+
+    // the fine samples include the coarse ones: injection, and the norm that the coarse sweeps left there
+    double coarseNorm = 0, fineNorm = 0;
+    for (int X = region.xStart + 1; X < region.xEnd - 1; ++X)
+        for (int Y = region.yStart + 1; Y < region.yEnd - 1; ++Y)
+        {
+            int i = (X - region.xStart)*r, j = (Y - region.yStart)*r;
+            coarseNorm += coarse.reCur(X, Y)*coarse.reCur(X, Y) + coarse.imCur(X, Y)*coarse.imCur(X, Y);
+            fineNorm += fine.reCur(i, j)*fine.reCur(i, j) + fine.imCur(i, j)*fine.imCur(i, j);
+        }
+    if (fineNorm <= 0)
+        return;
+
+    // the coarse sweeps conserve the norm, so the injected samples are scaled back to it: the patch only decides how
+    // the probability is distributed inside of it, not how much of it there is. The fine samples are scaled as well,
+    // so that they still agree with the coarse ones
+    double scale = sqrt(coarseNorm/fineNorm);
+    for (int i = 0; i < fine.sizeX(); ++i)
+        for (int j = 0; j < fine.sizeY(); ++j)
+        {
+            fine.reCur(i, j) *= scale;
+            fine.imCur(i, j) *= scale;
+        }
+
+    for (int X = region.xStart + 1; X < region.xEnd - 1; ++X)
+        for (int Y = region.yStart + 1; Y < region.yEnd - 1; ++Y)
+        {
+            int i = (X - region.xStart)*r, j = (Y - region.yStart)*r;
+            coarse.reCur(X, Y) = fine.reCur(i, j);
+            coarse.imCur(X, Y) = fine.imCur(i, j);
+        }
+}
@@ -0,0 +1,104 @@
+#include "batch.h"
+#include "kernels.h"
+#include "threadpool.h"
+
+#include <algorithm>
+
+
+PacketBatch::PacketBatch(const Grid& grid, const vector<Packet>& packets, double dR, int order)
+    : grid(grid), packets(packets), dR(dR), order(order)
+{
+    const int nx = grid.sizeX(), ny = grid.sizeY();
+    lanes = max(1, (size() + BATCH_LANE_MULTIPLE - 1)/BATCH_LANE_MULTIPLE)*BATCH_LANE_MULTIPLE;
+
+    // zeroed: the ghost cells and the padding lanes are never written to after this
+    re.assign(grid.planeSize()*lanes, 0.0);
+    im.assign(grid.planeSize()*lanes, 0.0);
+    ThreadPool::global().parallelFor(nx, [&](int x)
+    {
+        for (int y = 0; y < ny; ++y)
+            for (int b = 0; b < size(); ++b)
+            {
+                cdouble value = computeInitial(grid.xCoord(x), grid.yCoord(y), packets[b]);
+                re[lane(x, y) + b] = value.real();
+                im[lane(x, y) + b] = value.imag();
+            }
+    });
+}
+
+
+void PacketBatch::advance(const vector<Sweep>& sweeps)
+{
+    const int nx = grid.sizeX(), ny = grid.sizeY();
+    const int numBands = (nx + BATCH_BAND_ROWS - 1)/BATCH_BAND_ROWS;
+    const double* coeffs = laplacianCoefficients(order);
+    const BatchKernel kernel = batchKernel(order);
+
+    // same weights as computeNextSegment
+    vector<BatchArgs> args(sweeps.size());
+    for (size_t i = 0; i < sweeps.size(); ++i)
+    {
+        double sign = (sweeps[i].mode == R) ? 1.0 : -1.0;
+        args[i].length = ny;
+        args[i].lanes = lanes;
+        args[i].stride = grid.getStride()*lanes;
+        args[i].potentialWeight = sign*sweeps[i].timeStep;
+        for (int k = 0; k <= STENCIL_MAX_RADIUS; ++k)
+            args[i].weights[k] = -sign*sweeps[i].timeStep*coeffs[k]/(2.0*dR*dR);
+    }
+
+    // a wavefront through BATCH_DEPTH sweeps at a time: at step t, sweep s is on band t - 2s
+    //  - the band below it was just done by sweep s - 1 (its stencil reaches at most one band further)
+    //  - sweep s - 1 is two bands ahead, where it no longer reads the rows that sweep s writes
+    // only about 2*BATCH_DEPTH bands are being worked on at any time: those stay in cache from one sweep to the next
+    // that is too few tasks for the pool, so each band is also split into columns: a sweep only writes the samples it
+    // is on and reads the other component, so the columns of a band are independent
+    ThreadPool& pool = ThreadPool::global();
+    for (size_t first = 0; first < sweeps.size(); first += BATCH_DEPTH)
+    {
+        int depth = int(min(sweeps.size() - first, size_t(BATCH_DEPTH)));
+        int numColumns = max(1, min((2*pool.size() + depth - 1)/depth, ny/BATCH_MIN_COLUMNS));
+        for (int t = 0; t < numBands + 2*(depth - 1); ++t)
+        {
+            int sFirst = max(0, (t - numBands + 2)/2), sLast = min(depth - 1, t/2);
+            pool.parallelFor((sLast - sFirst + 1)*numColumns, [&](int task)
+            {
+                int s = sFirst + task/numColumns, column = task%numColumns;
+                int band = t - 2*s;
+                int yStart = int((long long)ny*column/numColumns), yEnd = int((long long)ny*(column + 1)/numColumns);
+                const Sweep& sweep = sweeps[first + s];
+                BatchArgs row = args[first + s];
+                row.length = yEnd - yStart;
+                for (int x = band*BATCH_BAND_ROWS; x < min(nx, (band + 1)*BATCH_BAND_ROWS); ++x)
+                {
+                    row.cur = ((sweep.mode == R) ? re.data() : im.data()) + lane(x, yStart);
+                    row.other = ((sweep.mode == R) ? im.data() : re.data()) + lane(x, yStart);
+                    row.V = grid.VPlane() + grid.index(x, yStart);
+                    kernel(row);
+                }
+            });
+        }
+    }
+}
+
+
+double PacketBatch::getProbability(int b, int x1, int x2, int y1, int y2) const
+{
+    double sum = 0;
+    for (int i = min(x1, x2); i <= max(x1, x2); ++i)
+        for (int j = min(y1, y2); j <= max(y1, y2); ++j)
+            sum += reCur(b, i, j)*reCur(b, i, j) + imCur(b, i, j)*imCur(b, i, j);
+
+    return sum*dR*dR;
+}
+
+
+void PacketBatch::extract(int b, Grid& out) const
+{
+    for (int x = 0; x < grid.sizeX(); ++x)
+        for (int y = 0; y < grid.sizeY(); ++y)
+        {
+            out.reCur(x, y) = reCur(b, x, y);
+            out.imCur(x, y) = imCur(b, x, y);
+        }
+}
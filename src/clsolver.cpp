@@ -0,0 +1,450 @@
+#include "clsolver.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef QUTOSS_OPENCL
+#include "cl.hpp"
+
+
+// one sweep kernel per stencil radius (as the row kernels), the loops over the rings unroll
+// dimension 0 runs along y, so neighbouring work-items read neighbouring samples
+static const char* kernelSource = R"(
+#ifdef USE_AMD_FP64
+#pragma OPENCL EXTENSION cl_amd_fp64 : enable
+#else
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+// the operations of rowScalar, in its order: no fused multiply-adds
+#pragma OPENCL FP_CONTRACT OFF
+
+#define SWEEP(R) \
+__kernel void sweep##R(__global double* cur, __global const double* other, __global const double* V, int origin, \
+                       int stride, double w0, double w1, double w2, double w3, double w4, double potentialWeight) \
+{ \
+    const double w[5] = { w0, w1, w2, w3, w4 }; \
+    const int i = origin + (int)get_global_id(1)*stride + (int)get_global_id(0); \
+    const __global double* o = other + i; \
+    double update = (w[0] + potentialWeight*V[i])*o[0]; \
+    for (int k = 1; k <= R; ++k) \
+        update += w[k]*((o[-k] + o[k]) + (o[-k*stride] + o[k*stride])); \
+    cur[i] += update; \
+}
+
+SWEEP(1)
+SWEEP(2)
+SWEEP(3)
+SWEEP(4)
+
+
+// one work-item per row of [x1, x2], the first one of a group adds up those of the group
+__kernel void probability(__global const double* re, __global const double* im, int origin, int stride,
+                          int x1, int x2, int y1, int y2, __local double* rows, __global double* partial)
+{
+    const int x = x1 + (int)get_global_id(0), l = (int)get_local_id(0);
+    double sum = 0;
+    if (x <= x2)
+    {
+        const int i = origin + x*stride;
+        for (int y = y1; y <= y2; ++y)
+            sum += re[i + y]*re[i + y] + im[i + y]*im[i + y];
+    }
+    rows[l] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (l == 0)
+    {
+        for (int r = 1; r < (int)get_local_size(0); ++r)
+            sum += rows[r];
+        partial[get_group_id(0)] = sum;
+    }
+}
+
+
+// the colour maps of ColorMapper that updateGrid uses
+void hot(double s, double* c)
+{
+    c[0] = (s < 0.5) ? 2.0*s : 1.0;
+    c[1] = (s < 0.25) ? 0.0 : (s > 0.75) ? 1.0 : 2.0*(s - 0.25);
+    c[2] = (s < 0.5) ? 0.0 : 2.0*(s - 0.5);
+}
+
+void jet(double s, double* c)
+{
+    if (s < 0.1125)
+    {
+        c[0] = 0; c[1] = 0; c[2] = 4*s + 0.55;
+    }
+    else if (s < 0.3625)
+    {
+        c[0] = 0; c[1] = 4*(s - 0.25) + 0.55; c[2] = 1;
+    }
+    else if (s < 0.6125)
+    {
+        c[0] = 4*(s - 0.5) + 0.55; c[1] = 1; c[2] = -4*(s - 0.75) - 0.55;
+    }
+    else if (s < 0.8625)
+    {
+        c[0] = 1; c[1] = -4*(s - 1) - 0.55; c[2] = 0;
+    }
+    else
+    {
+        c[0] = -4*(s - 1.25) - 0.55; c[1] = 0; c[2] = 0;
+    }
+}
+
+__kernel void colors(__global const double* re, __global const double* im, int origin, int stride, int ny,
+                     int drawMode, int cmap, double vmin, double vmax, int preview,
+                     __global double* values, __global float* rgb)
+{
+    const int y = (int)get_global_id(0), x = (int)get_global_id(1);
+    const int i = origin + x*stride + y, out = x*ny + y;
+
+    const double value = (drawMode == 'P') ? im[i]*im[i] + re[i]*re[i] : (drawMode == 'R') ? re[i] : im[i];
+    const double s = (min(max(value, vmin), vmax) - vmin)/(vmax - vmin);
+
+    double c[3];
+    if (cmap == 'h')
+        hot(s, c);
+    else if (cmap == 'j')
+        jet(s, c);
+    else
+    {
+        c[0] = s; c[1] = -s + 1.0; c[2] = 1.0;
+    }
+    if (preview)
+    {
+        c[1] *= 0.5;
+        c[2] *= 0.5;
+    }
+
+    values[out] = value;
+    rgb[3*out] = (float)c[0];
+    rgb[3*out + 1] = (float)c[1];
+    rgb[3*out + 2] = (float)c[2];
+}
+)";
+
+
+struct OpenCLSolver::Device
+{
+    cl::Device device;
+    cl::Context context;
+    cl::CommandQueue queue;
+    cl::Program program;
+    cl::Kernel sweeps[STENCIL_MAX_RADIUS + 1];   // indexed by stencil radius, entry 0 is unused
+    cl::Kernel probability, colors;
+    size_t groupSize = CLSOLVER_ROWS_PER_GROUP;   // of probability
+
+    cl::Buffer re, im, V;          // resident, same layout as the planes of Grid
+    cl::Buffer values, colorData;  // output of colors
+    cl::Buffer partial;            // of probability, one sum per group
+    vector<double> partialSums;
+};
+
+
+// the arguments of kernel from index on, stops at the first one that fails
+static cl_int setArgs(cl::Kernel&, cl_uint) { return CL_SUCCESS;}
+
+template<typename T, typename... Rest>
+static cl_int setArgs(cl::Kernel& kernel, cl_uint index, const T& value, const Rest&... rest)
+{
+    cl_int error = kernel.setArg(index, value);
+    return (error != CL_SUCCESS) ? error : setArgs(kernel, index + 1, rest...);
+}
+
+
+static bool hasDoubles(const cl::Device& device, bool& amd)
+{
+    string extensions = device.getInfo<CL_DEVICE_EXTENSIONS>();
+    amd = extensions.find("cl_khr_fp64") == string::npos && extensions.find("cl_amd_fp64") != string::npos;
+    return extensions.find("cl_khr_fp64") != string::npos || amd;
+}
+
+
+OpenCLSolver::OpenCLSolver() : device(new Device())
+{
+    vector<cl::Platform> platforms;
+    if (cl::Platform::get(&platforms) != CL_SUCCESS || platforms.empty())
+    {
+        status = "no OpenCL platform was found (no runtime, such as PoCL, is installed)";
+        return;
+    }
+
+    // QUTOSS_OPENCL_DEVICE overrides the choice, otherwise a GPU wins over anything else
+    const char* wanted = getenv("QUTOSS_OPENCL_DEVICE");
+    cl::Device chosen;
+    bool found = false, chosenGpu = false, chosenAmd = false;
+    for (size_t p = 0; p < platforms.size(); ++p)
+    {
+        vector<cl::Device> devices;
+        if (platforms[p].getDevices(CL_DEVICE_TYPE_ALL, &devices) != CL_SUCCESS)
+            continue;
+
+        for (size_t d = 0; d < devices.size(); ++d)
+        {
+            bool amd;
+            if (!devices[d].getInfo<CL_DEVICE_AVAILABLE>() || !hasDoubles(devices[d], amd))
+                continue;
+
+            string name = devices[d].getInfo<CL_DEVICE_NAME>();
+            bool gpu = (devices[d].getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_GPU) != 0;
+            bool pick = (wanted != NULL) ? !found && name.find(wanted) != string::npos : !found || (gpu && !chosenGpu);
+            if (pick)
+            {
+                chosen = devices[d];
+                chosenGpu = gpu;
+                chosenAmd = amd;
+                found = true;
+            }
+        }
+    }
+
+    if (!found)
+    {
+        status = (wanted != NULL) ? "no OpenCL device named like \"" + string(wanted) + "\" has doubles"
+                                  : "no OpenCL device has doubles (cl_khr_fp64)";
+        return;
+    }
+
+    device->device = chosen;
+    deviceName = chosen.getInfo<CL_DEVICE_NAME>();
+
+    cl_int error;
+    vector<cl::Device> devices(1, chosen);
+    device->context = cl::Context(devices, NULL, NULL, NULL, &error);
+    if (error != CL_SUCCESS)
+    {
+        fail("creating the context", error);
+        return;
+    }
+    device->queue = cl::CommandQueue(device->context, chosen, 0, &error);
+    if (error != CL_SUCCESS)
+    {
+        fail("creating the command queue", error);
+        return;
+    }
+
+    cl::Program::Sources sources(1, make_pair(kernelSource, strlen(kernelSource)));
+    device->program = cl::Program(device->context, sources, &error);
+    if (error == CL_SUCCESS)
+        error = device->program.build(devices, chosenAmd ? "-D USE_AMD_FP64" : "");
+    if (error != CL_SUCCESS)
+    {
+        string log = device->program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(chosen);
+        fail("building the kernels (" + log + ")", error);
+        return;
+    }
+
+    for (int r = 1; r <= STENCIL_MAX_RADIUS; ++r)
+    {
+        device->sweeps[r] = cl::Kernel(device->program, ("sweep" + to_string(r)).c_str(), &error);
+        if (error != CL_SUCCESS)
+        {
+            fail("creating the sweep kernels", error);
+            return;
+        }
+    }
+    device->probability = cl::Kernel(device->program, "probability", &error);
+    if (error == CL_SUCCESS)
+        device->colors = cl::Kernel(device->program, "colors", &error);
+    if (error != CL_SUCCESS)
+    {
+        fail("creating the kernels", error);
+        return;
+    }
+
+    size_t limit = device->probability.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(chosen);
+    device->groupSize = max(size_t(1), min(device->groupSize, limit));
+    ready = true;
+}
+
+
+OpenCLSolver::~OpenCLSolver()
+{
+    // waits for whatever is still queued, before the buffers go
+    if (ready)
+        device->queue.finish();
+}
+
+
+bool OpenCLSolver::fail(const string& what, int error)
+{
+    status = what + " failed, OpenCL error " + to_string(error);
+    ready = false;
+    return false;
+}
+
+
+bool OpenCLSolver::upload(const Grid& grid)
+{
+    if (!ready)
+        return false;
+
+    cl_int error = CL_SUCCESS;
+    if (grid.planeSize() != planeSize || grid.sizeX() != nx || grid.sizeY() != ny || grid.getStride() != stride)
+    {
+        nx = grid.sizeX();
+        ny = grid.sizeY();
+        stride = grid.getStride();
+        origin = grid.index(0, 0);
+        planeSize = grid.planeSize();
+
+        // the old buffers are released first, so that both sets never have to fit at once
+        device->re = device->im = device->V = cl::Buffer();
+        device->values = device->colorData = device->partial = cl::Buffer();
+
+        const size_t numGroups = (nx + device->groupSize - 1)/device->groupSize;
+        cl::Buffer* planes[] = { &device->re, &device->im, &device->V };
+        for (cl::Buffer* plane : planes)
+            if (error == CL_SUCCESS)
+                *plane = cl::Buffer(device->context, CL_MEM_READ_WRITE, planeSize*sizeof(double), NULL, &error);
+        if (error == CL_SUCCESS)
+            device->values = cl::Buffer(device->context, CL_MEM_WRITE_ONLY, size_t(nx)*ny*sizeof(double), NULL, &error);
+        if (error == CL_SUCCESS)
+            device->colorData = cl::Buffer(device->context, CL_MEM_WRITE_ONLY, 3*size_t(nx)*ny*sizeof(float), NULL, &error);
+        if (error == CL_SUCCESS)
+            device->partial = cl::Buffer(device->context, CL_MEM_WRITE_ONLY, numGroups*sizeof(double), NULL, &error);
+        if (error != CL_SUCCESS)
+        {
+            planeSize = 0;
+            return fail("allocating the planes on the device", error);
+        }
+        device->partialSums.resize(numGroups);
+    }
+
+    const size_t bytes = planeSize*sizeof(double);
+    error = device->queue.enqueueWriteBuffer(device->re, CL_FALSE, 0, bytes, grid.rePlane());
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueWriteBuffer(device->im, CL_FALSE, 0, bytes, grid.imPlane());
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueWriteBuffer(device->V, CL_TRUE, 0, bytes, grid.VPlane());
+    if (error != CL_SUCCESS)
+        return fail("uploading the grid", error);
+    return true;
+}
+
+
+bool OpenCLSolver::download(Grid& grid)
+{
+    if (!ready || grid.planeSize() != planeSize)
+        return false;
+
+    // the queue is in order: once the second read is done, so is everything before it
+    const size_t bytes = planeSize*sizeof(double);
+    cl_int error = device->queue.enqueueReadBuffer(device->re, CL_FALSE, 0, bytes, grid.rePlane());
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueReadBuffer(device->im, CL_TRUE, 0, bytes, grid.imPlane());
+    if (error != CL_SUCCESS)
+        return fail("reading the wavefunction back", error);
+    return true;
+}
+
+
+bool OpenCLSolver::advance(const vector<Sweep>& sweeps, double dR, int order)
+{
+    if (!ready || planeSize == 0)
+        return false;
+
+    const double* coeffs = laplacianCoefficients(order);
+    cl::Kernel& kernel = device->sweeps[order/2];
+    const cl::NDRange global(ny, nx);
+
+    for (size_t i = 0; i < sweeps.size(); ++i)
+    {
+        // same weights as computeNextSegment
+        double sign = (sweeps[i].mode == R) ? 1.0 : -1.0;
+        double dT = sweeps[i].timeStep;
+        cl_double weights[STENCIL_MAX_RADIUS + 1];
+        for (int k = 0; k <= STENCIL_MAX_RADIUS; ++k)
+            weights[k] = -sign*dT*coeffs[k]/(2.0*dR*dR);
+
+        const cl::Buffer& cur = (sweeps[i].mode == R) ? device->re : device->im;
+        const cl::Buffer& other = (sweeps[i].mode == R) ? device->im : device->re;
+        cl_int error = setArgs(kernel, 0, cur, other, device->V, cl_int(origin), cl_int(stride), weights[0], weights[1],
+                               weights[2], weights[3], weights[4], cl_double(sign*dT));
+
+        // the arguments are captured by the enqueue: the next sweep can set its own right away
+        if (error == CL_SUCCESS)
+            error = device->queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NullRange);
+        if (error != CL_SUCCESS)
+            return fail("enqueueing a sweep", error);
+    }
+
+    // starts the device on them, without waiting
+    device->queue.flush();
+    return true;
+}
+
+
+bool OpenCLSolver::sumProbability(int x1, int x2, int y1, int y2, double& sum)
+{
+    if (!ready || planeSize == 0)
+        return false;
+
+    int xStart = max(0, min(x1, x2)), xEnd = min(nx - 1, max(x1, x2));
+    int yStart = max(0, min(y1, y2)), yEnd = min(ny - 1, max(y1, y2));
+    sum = 0;
+    if (xStart > xEnd || yStart > yEnd)
+        return true;
+
+    const size_t group = device->groupSize;
+    const size_t numGroups = (size_t(xEnd - xStart) + group)/group;
+    cl::Kernel& kernel = device->probability;
+    cl_int error = setArgs(kernel, 0, device->re, device->im, cl_int(origin), cl_int(stride), cl_int(xStart), cl_int(xEnd),
+                           cl_int(yStart), cl_int(yEnd), cl::__local(group*sizeof(double)), device->partial);
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(numGroups*group), cl::NDRange(group));
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueReadBuffer(device->partial, CL_TRUE, 0, numGroups*sizeof(double),
+                                                device->partialSums.data());
+    if (error != CL_SUCCESS)
+        return fail("summing the probability", error);
+
+    for (size_t g = 0; g < numGroups; ++g)
+        sum += device->partialSums[g];
+    return true;
+}
+
+
+bool OpenCLSolver::colorSamples(char drawMode, char cmap, double min, double max, bool preview,
+                                vector<double>& values, vector<float>& colors)
+{
+    if (!ready || planeSize == 0)
+        return false;
+
+    values.resize(size_t(nx)*ny);
+    colors.resize(3*size_t(nx)*ny);
+
+    cl::Kernel& kernel = device->colors;
+    cl_int error = setArgs(kernel, 0, device->re, device->im, cl_int(origin), cl_int(stride), cl_int(ny), cl_int(drawMode),
+                           cl_int(cmap), cl_double(min), cl_double(max), cl_int(preview), device->values,
+                           device->colorData);
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(ny, nx), cl::NullRange);
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueReadBuffer(device->values, CL_FALSE, 0, values.size()*sizeof(double), values.data());
+    if (error == CL_SUCCESS)
+        error = device->queue.enqueueReadBuffer(device->colorData, CL_TRUE, 0, colors.size()*sizeof(float), colors.data());
+    if (error != CL_SUCCESS)
+        return fail("mapping the colours", error);
+    return true;
+}
+
+
+#else   // QUTOSS_OPENCL
+
+
+struct OpenCLSolver::Device {};
+
+OpenCLSolver::OpenCLSolver() { status = "this build has no OpenCL support (configure it with CONFIG+=opencl)";}
+OpenCLSolver::~OpenCLSolver() {;}
+bool OpenCLSolver::fail(const string&, int) { return false;}
+bool OpenCLSolver::upload(const Grid&) { return false;}
+bool OpenCLSolver::download(Grid&) { return false;}
+bool OpenCLSolver::advance(const vector<Sweep>&, double, int) { return false;}
+bool OpenCLSolver::sumProbability(int, int, int, int, double&) { return false;}
+bool OpenCLSolver::colorSamples(char, char, double, double, bool, vector<double>&, vector<float>&) { return false;}
+
+#endif  // QUTOSS_OPENCL
@@ -4,26 +4,14 @@
 // 0 - 3 denote bottom 4 vertices, 4- 7 the top 4
 static QVector<QVector<int>> faces = {{7,6,2,3}, {6,5,1,2},{5,4,0,1},{4,7,3,0},{4,5,6,7}};
 
-Data::Data() : samplesPerSide(unsigned(sqrt(NUM_SAMPLES))),
-               dR(SIDE_LENGTH/(samplesPerSide-1))
-{
-    QVector<Point> colVec(sqrt(NUM_SAMPLES));
-    QVector<QVector<Point>> copy(sqrt(NUM_SAMPLES), colVec);
-    QVector<int> colVec2(sqrt(NUM_SAMPLES));
-    QVector<QVector<int>> copy2(sqrt(NUM_SAMPLES), colVec2);
-    gridData = copy;
-    simpsonCoeffs = copy2;
-    gridVertices.resize(unsigned(numVerticesAfterScaling(NUM_SAMPLES, resolution)*VERTEX_SIZE));
-    gridElements.resize(unsigned(pow(4.0,(resolution-1.0))*NUM_SAMPLES*6));
-
-    // tile vertices has capacity for rectangular tiles for every sample on dataGrid
-    // +1 for the red outlining points
-    tileVertices.resize(unsigned(4*NUM_SAMPLES*VERTEX_SIZE + 8*VERTEX_SIZE));
-    tileElements.resize(unsigned(6*NUM_SAMPLES));
-    funcMeshVertices.resize(unsigned(NUM_SAMPLES*VERTEX_SIZE));
+Data::Data() : samplesX(DEFAULT_SAMPLES_PER_SIDE), samplesY(DEFAULT_SAMPLES_PER_SIDE),
+               sideLengthX(DEFAULT_SIDE_LENGTH), sideLengthY(DEFAULT_SIDE_LENGTH),
+               dR(sideLengthX/(samplesX-1)),
+               stepSize(stableTimeStep(dR, stencilOrder))
+{
+    setWorldSideLength(sideLengthX);
+    allocateGridBuffers();
 
-    // number of sides x 2
-    funcMeshElements.resize(unsigned(4*(samplesPerSide*samplesPerSide - samplesPerSide)));
     indicatorVertices.resize(unsigned((5 + CIRCLE_SIDES_HD + 1)*VERTEX_SIZE));
     particlePerimeter.resize(unsigned(CIRCLE_SIDES));
     brushPerimeter.resize(unsigned(CIRCLE_SIDES_HD));
@@ -32,19 +20,10 @@ Data::Data() : samplesPerSide(unsigned(sqrt(NUM_SAMPLES))),
     netElements.resize(6*4);
     particleElements.resize(CIRCLE_SIDES*3);   // require CIRCLE_SIDES number of triangles to form a circle
     brushElements.resize(CIRCLE_SIDES_HD*3);
-    buckets = vector<double>(samplesPerSide*samplesPerSide);
 
-    initGridData();
-    initMeshVertices();
-    initGridVertices();
-    initGridElementData();
-    initFuncMeshElementData();
-    initTileVertexData();
-    initTileElementData();
     initNetElementData();
     initParticleElementData();
     initBrushElementData();
-    initSimpsonCoeffs();
     updateBrushRadius();
     resetAnchorAndStretch();
 
@@ -63,6 +42,173 @@ Data::Data() : samplesPerSide(unsigned(sqrt(NUM_SAMPLES))),
     indicatorVertices[9] = 0;
     indicatorVertices[10] = 1.0;
     indicatorVertices[11] = 0;
+
+    // QUTOSS_BACKEND=opencl: the sweeps start out on the OpenCL device, if there is one
+    const char* backend = getenv("QUTOSS_BACKEND");
+    if (backend != NULL && string(backend) == "opencl")
+    {
+        string message = setComputeBackend(OPENCL_BACKEND);
+        print("OpenCL: " + (message == "all is well" ? openCL->getDeviceName() : message + ", staying on the CPU"));
+    }
+}
+
+
+void Data::allocateGridBuffers()
+{
+    const int numSamples = samplesX*samplesY;
+    gridData.resize(samplesX, samplesY);
+    sweepRegion = { 0, int(samplesX), 0, int(samplesY) };
+    simpsonCoeffs = QVector<QVector<int>>(samplesX, QVector<int>(samplesY));
+    gridVertices.resize(unsigned(verticesAfterScaling(samplesX, resolution)*verticesAfterScaling(samplesY, resolution)*VERTEX_SIZE));
+    gridElements.resize(unsigned(pow(4.0,(resolution-1.0))*numSamples*6));
+
+    // tile vertices has capacity for rectangular tiles for every sample on dataGrid
+    // +1 for the red outlining points
+    tileVertices.resize(unsigned(4*numSamples*VERTEX_SIZE + 8*VERTEX_SIZE));
+    tileElements.resize(unsigned(6*numSamples));
+    funcMeshVertices.resize(unsigned(numSamples*VERTEX_SIZE));
+
+    // 2 per segment: nx*(ny - 1) of them along y, (nx - 1)*ny along x
+    funcMeshElements.resize(unsigned(2*(2*numSamples - samplesX - samplesY)));
+    buckets = vector<double>(numSamples);
+
+    initGridData();
+    initMeshVertices();
+    initGridVertices();
+    initGridElementData();
+    initFuncMeshElementData();
+    initTileVertexData();
+    initTileElementData();
+    initSimpsonCoeffs();
+    updateAbsorbingProfiles();
+}
+
+
+void Data::setDomain(int numSamplesX, int numSamplesY, double lengthX)
+{
+    // odd, for simpson's rule
+    numSamplesX = max(3, numSamplesX | 1);
+    numSamplesY = max(3, numSamplesY | 1);
+    if (unsigned(numSamplesX) == samplesX && unsigned(numSamplesY) == samplesY && lengthX == sideLengthX)
+        return;
+
+    // the potential (painted or not) is carried over to the new samples: bilinear in world coordinates,
+    // zero wherever the new domain goes past the old one
+    dropDeviceState();
+    Grid old = gridData;
+    double oldSideLengthX = sideLengthX, oldSideLengthY = sideLengthY, oldDR = dR;
+    int oldSamplesX = int(samplesX), oldSamplesY = int(samplesY);
+
+    // samples are square: the length along y follows from the spacing along x
+    samplesX = unsigned(numSamplesX);
+    samplesY = unsigned(numSamplesY);
+    sideLengthX = lengthX;
+    dR = sideLengthX/(samplesX - 1);
+    sideLengthY = dR*(samplesY - 1);
+    stepSize = stableTimeStep(dR, stencilOrder);
+    setWorldSideLength(max(sideLengthX, sideLengthY));
+
+    // clip the net and the tile being placed to the new grid
+    int lastX = int(samplesX) - 1, lastY = int(samplesY) - 1;
+    auto clip = [&](QPoint& p) { p = QPoint(min(p.x(), lastX), min(p.y(), lastY));};
+    clip(anchor);
+    clip(stretch);
+    clip(prevAnchor);
+    clip(prevStretch);
+    clip(netAnchor);
+    clip(netStretch);
+
+    // before anything else is written to the GL buffers, as they are still sized for the old grid
+    allocateGridBuffers();
+    emit domainChanged();
+
+    for (int x = 0; x < gridData.sizeX(); ++x)
+        for (int y = 0; y < gridData.sizeY(); ++y)
+        {
+            double u = (gridData.xCoord(x) + oldSideLengthX/2.0)/oldDR;
+            double v = (gridData.yCoord(y) + oldSideLengthY/2.0)/oldDR;
+            double V = 0.0;
+            if (u >= 0.0 && v >= 0.0 && u <= oldSamplesX - 1 && v <= oldSamplesY - 1)
+            {
+                int i = min(int(u), oldSamplesX - 2), j = min(int(v), oldSamplesY - 2);
+                double fu = u - i, fv = v - j;
+                V = (1.0 - fu)*((1.0 - fv)*old.V(i, j) + fv*old.V(i, j + 1)) +
+                    fu*((1.0 - fv)*old.V(i + 1, j) + fv*old.V(i + 1, j + 1));
+            }
+            gridData.V(x, y) = V;
+            gridData.VPreview(x, y) = V;
+        }
+    wallMaskValid = false;
+    patchesValid = false;
+
+    // everything that was computed for the old grid
+    nextRe.clear();
+    nextIm.clear();
+    reSingle.clear();
+    eigenValues.clear();
+    kineticPhaseStep = 0;
+    activeRegionValid = false;
+
+    tileNum = 0;
+    setTiles(false, true);
+    updateTileOrder();
+    updateBrushRadius();
+    updateArrow();
+    elapsedTime = 0;
+}
+
+
+void Data::setAbsorbingLayer(double width, double strength)
+{
+    absorbingWidth = max(0.0, width);
+    absorbingStrength = strength;
+    updateAbsorbingProfiles();
+}
+
+
+void Data::updateAbsorbingProfiles()
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+
+    // never more than half of the shorter side
+    absorbingSamples = min(int(rint(absorbingWidth/dR)), min(nx, ny)/2);
+
+    auto profile = [&](vector<double>& W, int n)
+    {
+        W.assign(n, 0.0);
+        for (int i = 0; i < n && absorbingSamples > 0; ++i)
+        {
+            int depth = absorbingSamples - min(i, n - 1 - i);
+            if (depth > 0)
+                W[i] = absorbingStrength*pow(double(depth)/absorbingSamples, 2.0);
+        }
+    };
+    profile(absorbingX, nx);
+    profile(absorbingY, ny);
+}
+
+
+template<typename T> void Data::absorbRow(Mode mode, int x, int yStart, int yEnd, T* re, T* im, double dT) const
+{
+    if (absorbingSamples == 0)
+        return;
+
+    T* component = (mode == R) ? re : im;
+    const int ny = gridData.sizeY();
+    auto damp = [&](int start, int end)
+    {
+        for (int y = max(start, yStart); y < min(end, yEnd); ++y)
+            component[y] *= T(exp(-(absorbingX[x] + absorbingY[y])*dT));
+    };
+
+    // rows inside of the layer are damped throughout, the others only at both ends
+    if (absorbingX[x] > 0.0)
+        damp(0, ny);
+    else
+    {
+        damp(0, absorbingSamples);
+        damp(ny - absorbingSamples, ny);
+    }
 }
 
 
@@ -84,23 +230,26 @@ void Data::restoreSaved()
 
 void Data::useFixedSettings()
 {
-    float xStart = -SIDE_LENGTH/6.0f;
-    float xEnd = xStart + SIDE_LENGTH/40.0f;
+    float xStart = -sideLengthX/6.0f;
+    float xEnd = xStart + sideLengthX/40.0f;
     double desiredPot = 22;
 
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            float xCoord = gridData[i][j].x;
+            float xCoord = gridData.xCoord(i);
             if (xCoord >= xStart && xCoord <= xEnd)
-                gridData[i][j].V = clipPotential(desiredPot);
+                gridData.V(i, j) = clipPotential(desiredPot);
             else
-                gridData[i][j].V = 0;
+                gridData.V(i, j) = 0;
         }
+    dropDeviceState();
+    wallMaskValid = false;
+    patchesValid = false;
 
     setTiles(false, true);
     updateTileOrder(false);
-    setCenter(0.2*SIDE_LENGTH/2.0, 0.0, false);
+    setCenter(0.2*sideLengthX/2.0, 0.0, false);
     setSpeed(6.5);
     setAngle(180);
 }
@@ -108,7 +257,7 @@ void Data::useFixedSettings()
 
 void Data::updateArrow()
 {
-    double distance = 0.25*SIDE_LENGTH*initialPacket.speed/double(MAX_SPEED);
+    double distance = 0.25*worldSideLength()*initialPacket.speed/double(MAX_SPEED);
     QVector3D direction(cos(DEG_TO_RAD*initialPacket.angle), sin(DEG_TO_RAD*initialPacket.angle), 0.0);
     QVector3D center(initialPacket.xCen, initialPacket.yCen, 0.0);
     initGridData();
@@ -168,6 +317,27 @@ void Data::setPrecision(double precision)
 }
 
 
+void Data::setPacket(const Packet& packet)
+{
+    initialPacket = clipPacket(packet);
+    initialPacketSaved = initialPacket;
+    initGridData();
+}
+
+
+void Data::setStencilOrder(int order)
+{
+    // anything else is rounded to the nearest order that has kernels
+    order = 2*max(1, min(STENCIL_MAX_RADIUS, (order + 1)/2));
+    if (order == stencilOrder)
+        return;
+
+    stencilOrder = order;
+    stepSize = stableTimeStep(dR, stencilOrder);   // wider stencils reach higher energies
+    eigenValues.clear();   // the eigenstates are those of the old laplacian
+}
+
+
 string Data::setEquation(const QString &s)
 {
     tileNum = 0;
@@ -177,21 +347,19 @@ string Data::setEquation(const QString &s)
     if (!message.empty() && message != "Values were clipped for stability") // latter is not a critical message worth aborting for
         return message;
 
-    for (int x = 0; x < gridData.size(); ++x)
-        for (int y = 0; y < gridData[0].size(); ++y)
+    for (int x = 0; x < gridData.sizeX(); ++x)
+        for (int y = 0; y < gridData.sizeY(); ++y)
         {
             // truncate values if necessary, and if so, notify the user
-            double xWorld = gridData[x][y].x;
-            double yWorld = gridData[x][y].y;
-            gridData[x][y].V =  parser.evaluateEquation(xWorld, yWorld);
-            gridData[x][y].V = clipPotential(gridData[x][y].V);
-            gridData[x][y].VPreview = gridData[x][y].V;
-            int index = (x*samplesPerSide + y)*6;
-            //funcMeshVertices[index+2] = potentialToGL(gridData[x][y].V);
-            //funcMeshVertices[index+3] = 0;
-            //funcMeshVertices[index+4] = 1.0;
-            //funcMeshVertices[index+5] = 0;
+            double xWorld = gridData.xCoord(x);
+            double yWorld = gridData.yCoord(y);
+            gridData.V(x, y) =  parser.evaluateEquation(xWorld, yWorld);
+            gridData.V(x, y) = clipPotential(gridData.V(x, y));
+            gridData.VPreview(x, y) = gridData.V(x, y);
         }
+    dropDeviceState();
+    wallMaskValid = false;
+    patchesValid = false;
 
     setTiles(false, true);
     updateTileOrder();
@@ -228,10 +396,10 @@ void Data::paintPotentialHelper(const QVector3D &worldP, double precision, doubl
 {
     // find the bounding box, based on the brushRadius member variable:
     // needed for setTiles as an optimization
-    int xMin = max(0, int((worldP.x() - brushRadius + SIDE_LENGTH/2.0)/dR));
-    int xMax = min(int(samplesPerSide-1), int((worldP.x() + brushRadius + SIDE_LENGTH/2.0)/dR));
-    int yMin = max(0, int((worldP.y() - brushRadius + SIDE_LENGTH/2.0)/dR));
-    int yMax = min(int(samplesPerSide-1), int((worldP.y() + brushRadius + SIDE_LENGTH/2.0)/dR));
+    int xMin = max(0, int((worldP.x() - brushRadius + sideLengthX/2.0)/dR));
+    int xMax = min(int(samplesX-1), int((worldP.x() + brushRadius + sideLengthX/2.0)/dR));
+    int yMin = max(0, int((worldP.y() - brushRadius + sideLengthY/2.0)/dR));
+    int yMax = min(int(samplesY-1), int((worldP.y() + brushRadius + sideLengthY/2.0)/dR));
 
     // setTiles will only update things between anchor and stretch
     anchor.setX(xMin);
@@ -248,16 +416,20 @@ void Data::paintPotentialHelper(const QVector3D &worldP, double precision, doubl
     unordered_set<int> onQueue;
 
     toVisit.push(QPoint(xCen, yCen));
-    onQueue.insert(xCen*samplesPerSide + yCen);
+    onQueue.insert(xCen*samplesY + yCen);
+
+    dropDeviceState();
+    wallMaskValid = false;
+    patchesValid = false;
 
     while(!toVisit.empty())
     {
         QPoint cur = toVisit.front();
-        double xdis = worldP.x() - gridData[cur.x()][cur.y()].x;
-        double ydis = worldP.y() - gridData[cur.x()][cur.y()].y;
-        gridData[cur.x()][cur.y()].V += height*exp(-(xdis*xdis + ydis*ydis)/pow(factor*spread,2.0));
-        gridData[cur.x()][cur.y()].V = clipPotential(gridData[cur.x()][cur.y()].V);
-        gridData[cur.x()][cur.y()].VPreview = gridData[cur.x()][cur.y()].V;
+        double xdis = worldP.x() - gridData.xCoord(cur.x());
+        double ydis = worldP.y() - gridData.yCoord(cur.y());
+        gridData.V(cur.x(), cur.y()) += height*exp(-(xdis*xdis + ydis*ydis)/pow(factor*spread,2.0));
+        gridData.V(cur.x(), cur.y()) = clipPotential(gridData.V(cur.x(), cur.y()));
+        gridData.VPreview(cur.x(), cur.y()) = gridData.V(cur.x(), cur.y());
 
         // add new ones to the toVisit list, if not already there
         for (int i = 0; i < moves.size(); ++i)
@@ -265,13 +437,13 @@ void Data::paintPotentialHelper(const QVector3D &worldP, double precision, doubl
             int nextX = cur.x() + moves[i][0];
             int nextY = cur.y() + moves[i][1];
 
-            if (min(nextX, nextY) < 0 || max(nextX, nextY) >= gridData.size())
+            if (min(nextX, nextY) < 0 || nextX >= gridData.sizeX() || nextY >= gridData.sizeY())
                 continue;
             if (xdis*xdis + ydis*ydis > brushRadius*brushRadius)
                 break;
 
             QPoint next(nextX, nextY);
-            int index = next.x()*gridData.size() + next.y();
+            int index = next.x()*gridData.sizeY() + next.y();
             if (onQueue.find(index) == onQueue.end())
             {
                 onQueue.insert(index);
@@ -304,31 +476,31 @@ pair<QPoint, QPoint> Data::getAnchorAndStretch(const QPoint &anchorBlockID, cons
 
     if (anchorBlockID.x() > stretchBlockID.x())
     {
-        if (anchorBlockID.x() + 2*spacing - 1 <= gridData.size() - 1)
+        if (anchorBlockID.x() + 2*spacing - 1 <= gridData.sizeX() - 1)
             newAnchor.setX(anchorBlockID.x() + spacing - 1);
         else
-            newAnchor.setX(gridData.size() - 1);
+            newAnchor.setX(gridData.sizeX() - 1);
     }
     else
     {
-        if (stretchBlockID.x() + 2*spacing - 1 <= gridData.size() - 1)
+        if (stretchBlockID.x() + 2*spacing - 1 <= gridData.sizeX() - 1)
             newStretch.setX(stretchBlockID.x() + spacing - 1);
         else
-            newStretch.setX(gridData.size() - 1);
+            newStretch.setX(gridData.sizeX() - 1);
     }
     if (anchorBlockID.y() > stretchBlockID.y())
     {
-        if (anchorBlockID.y() + 2*spacing - 1 <= gridData[0].size() - 1)
+        if (anchorBlockID.y() + 2*spacing - 1 <= gridData.sizeY() - 1)
             newAnchor.setY(anchorBlockID.y() + spacing - 1);
         else
-            newAnchor.setY(gridData[0].size() - 1);
+            newAnchor.setY(gridData.sizeY() - 1);
     }
     else
     {
-        if (stretchBlockID.y() + 2*spacing - 1 <= gridData[0].size() - 1)
+        if (stretchBlockID.y() + 2*spacing - 1 <= gridData.sizeY() - 1)
             newStretch.setY(stretchBlockID.y() + spacing - 1);
         else
-            newStretch.setY(gridData[0].size() - 1);
+            newStretch.setY(gridData.sizeY() - 1);
     }
 
     return make_pair(newAnchor, newStretch);
@@ -343,9 +515,9 @@ void Data::setAnchor(const QVector3D& start, const QVector3D& direction)
 
     anchorBlockID = findClosestIndices(start, direction, placementSpacing);
 
-    if (anchorBlockID.x() >= gridData.size()-1)
+    if (anchorBlockID.x() >= gridData.sizeX()-1)
         anchorBlockID.setX(anchorBlockID.x() - placementSpacing + 1);
-    if (anchorBlockID.y() >= gridData[0].size()-1)
+    if (anchorBlockID.y() >= gridData.sizeY()-1)
         anchorBlockID.setY(anchorBlockID.y() - placementSpacing + 1);
 
     stretchBlockID = anchorBlockID;
@@ -366,9 +538,9 @@ void Data::setStretch(const QVector3D& start, const QVector3D& direction)
 
     stretchBlockID = findClosestIndices(start, direction, placementSpacing);
 
-    if (stretchBlockID.x() >= gridData.size()-1)
+    if (stretchBlockID.x() >= gridData.sizeX()-1)
         stretchBlockID.setX(stretchBlockID.x() - placementSpacing);
-    if (stretchBlockID.y() >= gridData[0].size()-1)
+    if (stretchBlockID.y() >= gridData.sizeY()-1)
         stretchBlockID.setY(stretchBlockID.y() - placementSpacing);
 
     pair<QPoint, QPoint> couple = getAnchorAndStretch(anchorBlockID, stretchBlockID, placementSpacing);
@@ -381,7 +553,7 @@ void Data::setStretch(const QVector3D& start, const QVector3D& direction)
 void Data::setBrush(const QVector3D &start, const QVector3D &direction)
 {
     QPoint closest = findClosestIndices(start, direction, 1);
-    brushCenter = {float(indexToWorld(closest.x(), dR)), float(indexToWorld(closest.y(), dR)), 0.0};
+    brushCenter = {float(gridData.xCoord(closest.x())), float(gridData.yCoord(closest.y())), 0.0};
     updateBrush();
 }
 
@@ -412,11 +584,12 @@ void Data::setPotentialFromStretch(double vertStretch)
 
 bool Data::withinPacketVicinity(const QVector3D &GLPoint)
 {
+    fetchDeviceState();
     QPoint closest = findClosestIndicesFlat(GLPoint, 1);
     int x = closest.x();
     int y = closest.y();
 
-    double prob = pow(gridData[x][y].imCur, 2.0) + pow(gridData[x][y].reCur, 2.0);
+    double prob = pow(gridData.imCur(x, y), 2.0) + pow(gridData.reCur(x, y), 2.0);
 
     if (prob >= ROUND_TO_ZERO)
         return true;
@@ -438,6 +611,8 @@ bool Data::withinArrowVicinity(const QVector3D &GLPoint)
 // p is in GLcoordinates [-1, 1]
 void Data::setCenter(const QVector3D& p, bool preview)
 {
+    fetchDeviceState();
+
     // compute the approx. radius of the current Packet
     center = findClosestIndicesFlat(QVector3D(initialPacket.xCen, initialPacket.yCen, 0), 1, true) ;  // use the current center
     int i = center.x();
@@ -446,9 +621,9 @@ void Data::setCenter(const QVector3D& p, bool preview)
     // the radius can be defined given value of ROUND_TO_ZERO
     if (initialPacket.xCen <= 0)
     {
-        while (i < gridData.size() - 1)
+        while (i < gridData.sizeX() - 1)
         {
-            if (fabs(gridData[i][center.y()].reCur) < ROUND_TO_ZERO && fabs(gridData[i][center.y()].imCur) < ROUND_TO_ZERO)
+            if (fabs(gridData.reCur(i, center.y())) < ROUND_TO_ZERO && fabs(gridData.imCur(i, center.y())) < ROUND_TO_ZERO)
                 break;
             ++i;
         }
@@ -457,7 +632,7 @@ void Data::setCenter(const QVector3D& p, bool preview)
     {
         while (i > 0)
         {
-            if (fabs(gridData[i][center.y()].reCur) < ROUND_TO_ZERO && fabs(gridData[i][center.y()].imCur) < ROUND_TO_ZERO)
+            if (fabs(gridData.reCur(i, center.y())) < ROUND_TO_ZERO && fabs(gridData.imCur(i, center.y())) < ROUND_TO_ZERO)
                 break;
             --i;
         }
@@ -465,17 +640,15 @@ void Data::setCenter(const QVector3D& p, bool preview)
 
     // update center
     // clip coordinates here ... (the center cannot be too close to the edges, or can it?)
-    double radius = fabs(indexToWorld(i, dR) - initialPacket.xCen);
+    double radius = fabs(gridData.xCoord(i) - initialPacket.xCen);
     center = findClosestIndicesFlat(p, 1);
-    double xCen = indexToWorld(center.x(), dR);
-    double yCen = indexToWorld(center.y(), dR);
-    double lowBound = -SIDE_LENGTH/2 + radius;
-    double highBound = SIDE_LENGTH/2 - radius;
+    double xCen = gridData.xCoord(center.x());
+    double yCen = gridData.yCoord(center.y());
 
-    xCen = min(xCen, highBound);
-    xCen = max(xCen, lowBound);
-    yCen = min(yCen, highBound);
-    yCen = max(yCen, lowBound);
+    xCen = min(xCen, sideLengthX/2 - radius);
+    xCen = max(xCen, -sideLengthX/2 + radius);
+    yCen = min(yCen, sideLengthY/2 - radius);
+    yCen = max(yCen, -sideLengthY/2 + radius);
 
     initialPacket.xCen = xCen;
     initialPacket.yCen = yCen;
@@ -493,9 +666,9 @@ void Data::setVelocity(const QVector3D &p)
     QVector3D center(initialPacket.xCen, initialPacket.yCen, 0.0);
     QVector3D direction = (worldP - center).normalized();
     double stretch = worldP.distanceToPoint(center);
-    double maxRadius = 0.25*SIDE_LENGTH;
+    double maxRadius = 0.25*worldSideLength();
 
-    // 0.25*SIDE_LENGTH is mapped to MAX_SPEED = 6.0 (look at computations.h for details)
+    // 0.25*worldSideLength() is mapped to MAX_SPEED = 6.0 (look at computations.h for details)
     if (stretch > maxRadius)
     {
         // calculate intersection of radius with line formed by worldP and center:
@@ -618,21 +791,28 @@ void Data::addPotential(int x1, int x2, int y1, int y2, double potential, bool p
 
     for (int i = startX ; i <= endX; ++i)
         for (int j = startY; j <= endY; ++j)
-            gridData[i][j].VPreview = gridData[i][j].V;
+            gridData.VPreview(i, j) = gridData.V(i, j);
+
+    if (!preview)
+    {
+        dropDeviceState();
+        wallMaskValid = false;
+        patchesValid = false;
+    }
 
     for (int i = min(x1, x2); i <= max(x1, x2); ++i)
         for (int j = min(y1, y2); j <= max(y1, y2); ++j)
         {
             if (!preview)
             {
-                gridData[i][j].V += potential;
-                gridData[i][j].V = clipPotential(gridData[i][j].V);
+                gridData.V(i, j) += potential;
+                gridData.V(i, j) = clipPotential(gridData.V(i, j));
             }
             else
             {
-                gridData[i][j].VPreview = gridData[i][j].V;
-                gridData[i][j].VPreview += potential;
-                gridData[i][j].VPreview = clipPotential(gridData[i][j].VPreview);
+                gridData.VPreview(i, j) = gridData.V(i, j);
+                gridData.VPreview(i, j) += potential;
+                gridData.VPreview(i, j) = clipPotential(gridData.VPreview(i, j));
             }
         }
 }
@@ -640,15 +820,15 @@ void Data::addPotential(int x1, int x2, int y1, int y2, double potential, bool p
 
 void Data::setMesh(bool preview)
 {
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
             double height;
-            int index = (i*gridData.size() + j)*VERTEX_SIZE;
+            int index = (i*gridData.sizeY() + j)*VERTEX_SIZE;
             if (preview)
-                height = potentialToGL(gridData[i][j].VPreview);
+                height = potentialToGL(gridData.VPreview(i, j));
             else
-                height = potentialToGL(gridData[i][j].V);
+                height = potentialToGL(gridData.V(i, j));
 
             funcMeshVertices[index + 2] = height;
             funcMeshVertices[index + 3] = 0;
@@ -665,16 +845,16 @@ void Data::updateTileOrder(bool preview)
     tileOrganizer.clear();
 
     // nlogn insertion, but sorted to make our lives easier
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            int index = i*gridData.size() + j;
+            int index = i*gridData.sizeY() + j;
             int val;
 
             if (preview)
-                val = rint(gridData[i][j].VPreview*100);
+                val = rint(gridData.VPreview(i, j)*100);
             else
-                val = rint(gridData[i][j].V*100);
+                val = rint(gridData.V(i, j)*100);
 
             tileOrganizer.insert(make_pair(val, index));
         }
@@ -712,324 +892,1430 @@ void Data::setTiles(bool preview, bool setAll)
         for (int i = min(prevAnchor.x(), prevStretch.x()); i <= max(prevAnchor.x(), prevStretch.x()); ++i)
             for (int j = min(prevAnchor.y(), prevStretch.y()); j <= max(prevAnchor.y(), prevStretch.y()); ++j)
             {
-                tileNum = i*samplesPerSide + j;
-                setTile(tileNum, i, i, j, j, gridData[i][j].V, false);
+                tileNum = i*samplesY + j;
+                setTile(tileNum, i, i, j, j, gridData.V(i, j), false);
             }
 
         for (int i = min(anchor.x(), stretch.x()); i <= max(anchor.x(), stretch.x()); ++i)
             for (int j = min(anchor.y(), stretch.y()); j <= max(anchor.y(), stretch.y()); ++j)
             {
-                tileNum = i*samplesPerSide + j;
+                tileNum = i*samplesY + j;
 
                 if (preview)
-                    setTile(tileNum, i, i, j, j, gridData[i][j].VPreview, false);
+                    setTile(tileNum, i, i, j, j, gridData.VPreview(i, j), false);
                 else
-                    setTile(tileNum, i, i, j, j, gridData[i][j].V, false);
+                    setTile(tileNum, i, i, j, j, gridData.V(i, j), false);
             }
     }
     else
     {
-        for (int i = 0; i < gridData.size(); ++i)
-            for (int j = 0; j < gridData[0].size(); ++j)
+        for (int i = 0; i < gridData.sizeX(); ++i)
+            for (int j = 0; j < gridData.sizeY(); ++j)
             {
-                tileNum = i*samplesPerSide + j;
+                tileNum = i*samplesY + j;
 
                 if (preview)
-                    setTile(tileNum, i, i, j, j, gridData[i][j].VPreview, false);
+                    setTile(tileNum, i, i, j, j, gridData.VPreview(i, j), false);
                 else
-                    setTile(tileNum, i, i, j, j, gridData[i][j].V, false);
+                    setTile(tileNum, i, i, j, j, gridData.V(i, j), false);
+            }
+    }
+
+    if (preview)
+        setTile(samplesX*samplesY, anchor.x(), stretch.x(), anchor.y(), stretch.y(), 0, true);
+
+    emit updateTileVbo();
+}
+
+
+// helper functions to GLWidget::initData()
+void Data::initGridData()
+{
+    elapsedTime = 0.0;
+
+    // all of the wavefunction is written over: nothing to fetch from the device, it gets the new one on its next frame
+    deviceCurrent = false;
+    hostCurrent = true;
+
+    // the domain is centered on the origin
+    for (int x = 0; x < int(samplesX); ++x)
+        gridData.setXCoord(x, (double(x)*(2.0/(double(samplesX) - 1.0)) - 1.0)*sideLengthX/2.0);
+    for (int y = 0; y < int(samplesY); ++y)
+        gridData.setYCoord(y, (double(y)*(2.0/(double(samplesY) - 1.0)) - 1.0)*sideLengthY/2.0);
+
+    for (int x = 0; x < int(samplesX); ++x)
+    {
+        // note that x by itself is an index
+        double xWorldPos = gridData.xCoord(x);
+        for (int y = 0; y < int(samplesY); ++y)
+        {
+            double yWorldPos = gridData.yCoord(y);
+            cdouble cval = computeInitial(xWorldPos, yWorldPos, initialPacket);
+
+            gridData.reBefore(x, y) = cval.real();
+            gridData.reCur(x, y) = gridData.reBefore(x, y);
+            gridData.imBefore(x, y) = cval.imag();
+            gridData.imCur(x, y) = gridData.imBefore(x, y);
+        }
+    }
+    eigenProjected = false;
+    activeRegionValid = false;
+    wallMaskValid = false;
+    patchesValid = false;
+
+    particle.xCen = initialPacket.xCen;
+    particle.yCen = initialPacket.yCen;
+    particle.xVel = roundToPrecision(initialPacket.speed*cos(initialPacket.angle*DEG_TO_RAD), 2);
+    particle.yVel = roundToPrecision(initialPacket.speed*sin(initialPacket.angle*DEG_TO_RAD), 2);
+}
+
+
+void Data::initGridVertices()
+{
+    // note that not every point in gridVertices is represented by a sample :
+    // depending on the resolution setting, some vertices will be extrapolated
+    int verticesX = verticesAfterScaling(samplesX, resolution);
+    int verticesY = verticesAfterScaling(samplesY, resolution);
+    double vertexSpacing = dR/pow(2.0, resolution - 1);
+
+    for (int x = 0; x < verticesX; ++x)
+        for (int y = 0; y < verticesY; ++y)
+        {
+            int index = verticesY*x + y;
+            gridVertices[index*6] = worldToGL(indexToWorld(x, vertexSpacing, sideLengthX));
+            gridVertices[index*6 + 1] = worldToGL(indexToWorld(y, vertexSpacing, sideLengthY));
+        }
+}
+
+
+void Data::initMeshVertices()
+{
+    // find appropriate shift
+    double enlargeFactor = 18.0;
+    double xStart = worldToGL(gridData.xCoord(0));
+    double xStartEnlarged = xStart*enlargeFactor;
+    double dist = xStart - xStartEnlarged;
+    double gridDistEnlarged = enlargeFactor*worldToGL(dR);
+    double indexEnlarged = floor(dist/gridDistEnlarged);
+    double xClosestEnlarged = xStartEnlarged + indexEnlarged*gridDistEnlarged;
+    double shift = xStart - xClosestEnlarged - worldToGL(0.5*dR);
+
+    for (int x = 0; x < int(samplesX); ++x)
+    {
+        double xGLPos = worldToGL(gridData.xCoord(x));
+        for (int y = 0; y < int(samplesY); ++y)
+        {
+            // note that x by itself is an index
+            double yGLPos = worldToGL(gridData.yCoord(y));
+            int index;
+
+            index = (x*samplesY + y)*VERTEX_SIZE;
+
+            funcMeshVertices[index] = enlargeFactor*xGLPos + shift;
+            funcMeshVertices[index+1] = enlargeFactor*yGLPos + shift;
+            funcMeshVertices[index+2] = -0.01;
+
+            // color needs to be interpolated depending on distance from center
+            Color cur;
+            double maxDist = 6.0;
+            double distArg = min(sqrt(pow(enlargeFactor*xGLPos + shift, 2.0) + pow(enlargeFactor*yGLPos + shift, 2.0))/maxDist, 1.0);
+
+            // interpolate to background color
+            cmap.getLinearInterpolated(distArg, Color(0.0, 0.0, 0.0), Color(0.16, 0.16, 0.2), cur);
+            funcMeshVertices[index+3] = cur.r;
+            funcMeshVertices[index+4] = cur.g;
+            funcMeshVertices[index+5] = cur.b;
+        }
+    }
+}
+
+
+void Data::initGridElementData()
+{
+    int k = 0;
+    int verticesX = verticesAfterScaling(samplesX, resolution);
+    int sideLength = verticesAfterScaling(samplesY, resolution);   // length of a row of vertices
+
+    for (int i = 0; i < verticesX - 1; ++i)
+        for (int j = 0; j < sideLength - 1; ++j)
+        {
+            int index = sideLength*i + j;
+
+            // for element where i and j are both odd/even, use down-slant square configuration
+            // for element where i and j are different parity, use up-slant square configuration
+            if (i%2 != j%2)
+            {
+                // first triangle
+                gridElements[k*6] = index;
+                gridElements[k*6+1] = index + sideLength;
+                gridElements[k*6+2] = index + 1;
+
+                // second triangle
+                gridElements[k*6+3] = index + sideLength + 1;
+                gridElements[k*6+4] = index + 1;
+                gridElements[k*6+5] = index + sideLength;
             }
+            else
+            {
+                // first triangle
+                gridElements[k*6] = index;
+                gridElements[k*6+1] = index + sideLength + 1;
+                gridElements[k*6+2] = index + 1;
+
+                // second triangle
+                gridElements[k*6+3] = index;
+                gridElements[k*6+4] = index + sideLength;
+                gridElements[k*6+5] = index + sideLength + 1;
+            }
+            ++k;
+        }
+}
+
+
+void Data::advanceSimulation(QMutex* chicken, bool onlyClassical)
+{
+    // first time, apply all changes in velocity and position
+    if (elapsedTime == 0)
+        initGridData();
+
+    Color color;
+    double refVal = 0;
+    Mode mode;
+
+    QFuture<void> supervisor = QtConcurrent::run(this, &Data::advanceSimulationClassical);
+
+    // run for a certain amount of timesteps (to speed up the animation)
+    // there is a limit to this depending on the CPU: frame lag will eventually appear if i is too great
+    for (int i = 0; i < (int)simSpeed; ++i)
+        elapsedTime += stepSize;
+
+    if (!onlyClassical)
+    {
+        // only the sweeps keep the active region up to date (and the walls at zero), the others write to the whole grid
+        if (integrator != VERLET && integrator != PEFRL)
+        {
+            dropDeviceState();
+            activeRegionValid = false;
+            wallMaskValid = false;
+            patchesValid = false;
+        }
+
+        switch (integrator)
+        {
+        case PEFRL:
+            runSweepsRefined(pefrlSweeps(stepSize, simSpeed), simSpeed*stepSize);
+            break;
+        case SPLIT_OPERATOR:
+            splitOperatorQuantum(simSpeed*stepSize);
+            break;
+        case ADI:
+            adiQuantum(simSpeed*stepSize);
+            break;
+        case EIGEN:
+            eigenQuantum(simSpeed*stepSize);
+            break;
+        case CHEBYSHEV:
+            chebyshevQuantum(simSpeed*stepSize);
+            break;
+        default:
+            runSweepsRefined(verletSweeps(stepSize, simSpeed), simSpeed*stepSize);
+        }
+    }
+
+    // wait for classicalSimulation update to finish (blocking, rather than spinning on a core the solver could use)
+    supervisor.waitForFinished();
+}
+
+
+void Data::verletQuantumParcel(double timeStep, int id, int numParcels)
+{
+    updateGridParcel(R, timeStep*0.5, id, numParcels);
+    updateGridParcel(I, timeStep, id, numParcels);
+    updateGridParcel(R, timeStep*0.5, id, numParcels);
+}
+
+
+void Data::updateGridParcel(Mode mode, double dT, int id, int numParcels)
+{
+    // parcels are blocks of whole rows of sweepRegion (rows are contiguous in memory)
+    // careful, as total number of samples may not be divisible by numParcels
+    // with stableOwnership they are blocks of the whole grid instead, cut down to the region: the same rows every time,
+    // those that the worker of the parcel first touched (see allocateOwned)
+    const Region& region = sweepRegion;
+    int firstRow = stableOwnership ? 0 : region.xStart;
+    int numRows = stableOwnership ? int(samplesX) : region.xEnd - region.xStart;
+    int xStart = max(region.xStart, firstRow + int((long long)numRows*id/numParcels));
+    int xEnd = min(region.xEnd, firstRow + int((long long)numRows*(id + 1)/numParcels)) - 1;
+
+    if (region.empty() || xStart > xEnd)
+        return;
+
+    if (singlePrecision)
+    {
+        const int stride = gridData.getStride();
+        for (int x = xStart; x <= xEnd; ++x)
+            forOpenSpans(x, region.yStart, region.yEnd, [&](int yStart, int yEnd)
+            {
+                int offset = gridData.index(x, yStart);
+                computeNextSegment(mode, reSingle.data() + offset, imSingle.data() + offset, VSingle.data() + offset,
+                                   yEnd - yStart, stride, dR, dT, stencilOrder);
+                absorbRow(mode, x, yStart, yEnd, reSingle.data() + offset - yStart, imSingle.data() + offset - yStart, dT);
+            });
+        return;
+    }
+
+    for (int x = xStart; x <= xEnd; ++x)
+        forOpenSpans(x, region.yStart, region.yEnd, [&](int yStart, int yEnd)
+        {
+            computeNextRow(mode, x, yStart, yEnd - 1, dR, dT, gridData, stencilOrder);
+            absorbRow(mode, x, yStart, yEnd, gridData.rePlane() + gridData.index(x, 0),
+                      gridData.imPlane() + gridData.index(x, 0), dT);
+        });
+}
+
+
+void Data::sweepGrid(Mode mode, double dT)
+{
+    // many more parcels than threads, so that work can be balanced by stealing
+    int numRows = stableOwnership ? int(samplesX) : sweepRegion.xEnd - sweepRegion.xStart;
+    int numParcels = (numRows + ROWS_PER_PARCEL - 1)/ROWS_PER_PARCEL;
+    ThreadPool::global().parallelFor(numParcels, [&](int id) { updateGridParcel(mode, dT, id, numParcels); });
+}
+
+
+// a 4-th order symplectic algorithm
+void Data::pefrlQuantum(double timeStep)
+{
+    runSweeps(pefrlSweeps(timeStep, 1));
+}
+
+
+void Data::splitOperatorQuantum(double timeStep, int numSteps)
+{
+    eigenProjected = false;
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    ThreadPool& pool = ThreadPool::global();
+    setupSplitOperator(timeStep);
+
+    pool.parallelFor(nx, [&](int x)
+    {
+        const double* re = gridData.rePlane() + gridData.index(x, 0);
+        const double* im = gridData.imPlane() + gridData.index(x, 0);
+        cdouble* psi = spectral.data() + size_t(x)*ny;
+        for (int y = 0; y < ny; ++y)
+            psi[y] = cdouble(re[y], im[y]);
+    });
+
+    // the closing e^(-iVdt/2) of a step and the opening one of the next merge into e^(-iVdt)
+    potentialPhase(timeStep*0.5);
+    for (int step = 0; step < numSteps; ++step)
+    {
+        if (step > 0)
+            potentialPhase(timeStep);
+
+        // the sine transform is its own inverse (kineticPhase takes care of the normalization)
+        sineTransform2D(sineX, sineY, spectral.data());
+        pool.parallelFor(nx, [&](int x)
+        {
+            cdouble* psi = spectral.data() + size_t(x)*ny;
+            const cdouble* phase = kineticPhase.data() + size_t(x)*ny;
+            for (int y = 0; y < ny; ++y)
+                psi[y] = multiply(psi[y], phase[y]);
+        });
+        sineTransform2D(sineX, sineY, spectral.data());
+    }
+    potentialPhase(timeStep*0.5);
+
+    pool.parallelFor(nx, [&](int x)
+    {
+        double* re = gridData.rePlane() + gridData.index(x, 0);
+        double* im = gridData.imPlane() + gridData.index(x, 0);
+        const cdouble* psi = spectral.data() + size_t(x)*ny;
+        for (int y = 0; y < ny; ++y)
+        {
+            re[y] = psi[y].real();
+            im[y] = psi[y].imag();
+        }
+    });
+}
+
+
+void Data::setupSplitOperator(double timeStep)
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    bool resized = sineX.size() != nx || sineY.size() != ny;
+
+    if (resized)
+    {
+        sineX = SinePlan(nx);
+        sineY = SinePlan(ny);
+        spectral.assign(size_t(nx)*ny, 0.0);
+        kineticPhase.assign(size_t(nx)*ny, 0.0);
+    }
+
+    if (!resized && kineticPhaseStep == timeStep)
+        return;
+
+    // sine mode k along x is sin(πk(x + 1)/(nx + 1)): it vanishes at the ghost cells right outside the grid,
+    // its kinetic energy is (πk/((nx + 1)dR))²/2 (H = -∇²/2 + V, same as the stencil solver)
+    double normalization = 4.0/(double(nx + 1)*double(ny + 1));
+    for (int x = 0; x < nx; ++x)
+    {
+        double kx = PI*(x + 1)/((nx + 1)*dR);
+        for (int y = 0; y < ny; ++y)
+        {
+            double ky = PI*(y + 1)/((ny + 1)*dR);
+            double energy = 0.5*(kx*kx + ky*ky);
+            kineticPhase[size_t(x)*ny + y] = polar(normalization, -energy*timeStep);
+        }
+    }
+    kineticPhaseStep = timeStep;
+}
+
+
+void Data::potentialPhase(double timeStep)
+{
+    const int ny = gridData.sizeY();
+    ThreadPool::global().parallelFor(gridData.sizeX(), [&](int x)
+    {
+        const double* V = gridData.VPlane() + gridData.index(x, 0);
+        cdouble* psi = spectral.data() + size_t(x)*ny;
+        for (int y = 0; y < ny; ++y)
+            psi[y] = multiply(psi[y], polar(1.0, -V[y]*timeStep));
+    });
+}
+
+
+void Data::adiQuantum(double timeStep, int numSteps)
+{
+    eigenProjected = false;
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    const int stride = gridData.getStride();
+    ThreadPool& pool = ThreadPool::global();
+    adiWave.resize(size_t(nx)*ny);
+    adiRhs.resize(size_t(nx)*ny);
+
+    pool.parallelFor(nx, [&](int x)
+    {
+        const double* re = gridData.rePlane() + gridData.index(x, 0);
+        const double* im = gridData.imPlane() + gridData.index(x, 0);
+        cdouble* psi = adiWave.data() + size_t(x)*ny;
+        for (int y = 0; y < ny; ++y)
+            psi[y] = cdouble(re[y], im[y]);
+    });
+
+    for (int step = 0; step < numSteps; ++step)
+    {
+        // (1 - iAydt/2)ψ, along rows
+        pool.parallelFor(nx, [&](int x)
+        {
+            adiExplicitLine(adiWave.data() + size_t(x)*ny, adiRhs.data() + size_t(x)*ny,
+                            gridData.VPlane() + gridData.index(x, 0), 1, ny, timeStep);
+        });
+
+        // ψ' = (1 + iAxdt/2)^-1 (that), then (1 - iAxdt/2)ψ' right away, while the column is at hand
+        pool.parallelFor(ny, [&](int y)
+        {
+            static thread_local vector<cdouble> column, explicitColumn;
+            column.resize(nx);
+            explicitColumn.resize(nx);
+            const double* V = gridData.VPlane() + gridData.index(0, y);
+
+            for (int x = 0; x < nx; ++x)
+                column[x] = adiRhs[size_t(x)*ny + y];
+            adiImplicitLine(column.data(), V, stride, nx, timeStep);
+            adiExplicitLine(column.data(), explicitColumn.data(), V, stride, nx, timeStep);
+            for (int x = 0; x < nx; ++x)
+                adiRhs[size_t(x)*ny + y] = explicitColumn[x];
+        });
+
+        // ψ'' = (1 + iAydt/2)^-1 (that), along rows
+        pool.parallelFor(nx, [&](int x)
+        {
+            cdouble* psi = adiWave.data() + size_t(x)*ny;
+            copy(adiRhs.begin() + size_t(x)*ny, adiRhs.begin() + size_t(x + 1)*ny, psi);
+            adiImplicitLine(psi, gridData.VPlane() + gridData.index(x, 0), 1, ny, timeStep);
+        });
+    }
+
+    pool.parallelFor(nx, [&](int x)
+    {
+        double* re = gridData.rePlane() + gridData.index(x, 0);
+        double* im = gridData.imPlane() + gridData.index(x, 0);
+        const cdouble* psi = adiWave.data() + size_t(x)*ny;
+        for (int y = 0; y < ny; ++y)
+        {
+            re[y] = psi[y].real();
+            im[y] = psi[y].imag();
+        }
+    });
+}
+
+
+void Data::adiExplicitLine(const cdouble* in, cdouble* out, const double* V, int VStride, int n, double timeStep)
+{
+    // 1-D laplacian: same weights as the 2-D one, except for half the center
+    const int radius = stencilOrder/2;
+    const double* coeffs = laplacianCoefficients(stencilOrder);
+    const double scale = -1.0/(2.0*dR*dR);
+
+    for (int j = 0; j < n; ++j)
+    {
+        // samples outside of the line are the walls (zero)
+        cdouble A = (scale*0.5*coeffs[0] + 0.5*V[j*VStride])*in[j];
+        for (int k = 1; k <= radius; ++k)
+        {
+            if (j - k >= 0)
+                A += scale*coeffs[k]*in[j - k];
+            if (j + k < n)
+                A += scale*coeffs[k]*in[j + k];
+        }
+
+        // in - i(dt/2)A
+        out[j] = in[j] + 0.5*timeStep*cdouble(A.imag(), -A.real());
+    }
+}
+
+
+void Data::adiImplicitLine(cdouble* line, const double* V, int VStride, int n, double timeStep)
+{
+    const int radius = stencilOrder/2;
+    const int width = 2*radius + 1;
+    const double* coeffs = laplacianCoefficients(stencilOrder);
+    const double scale = -1.0/(2.0*dR*dR);
+
+    // 1 + i(dt/2)A: the off-diagonals are purely imaginary, the diagonal has the potential in it as well
+    static thread_local vector<cdouble> bands;
+    bands.assign(size_t(n)*width, 0.0);
+    for (int j = 0; j < n; ++j)
+    {
+        cdouble* row = bands.data() + size_t(j)*width + radius;
+        row[0] = cdouble(1.0, 0.5*timeStep*(scale*0.5*coeffs[0] + 0.5*V[j*VStride]));
+        for (int k = 1; k <= radius; ++k)
+        {
+            if (j - k >= 0)
+                row[-k] = cdouble(0.0, 0.5*timeStep*scale*coeffs[k]);
+            if (j + k < n)
+                row[k] = cdouble(0.0, 0.5*timeStep*scale*coeffs[k]);
+        }
+    }
+
+    solveBanded(bands.data(), line, n, radius);
+}
+
+
+void Data::eigenQuantum(double timeStep)
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    bool potentialChanged = eigenPotential.size() != gridData.planeSize() ||
+                            !equal(eigenPotential.begin(), eigenPotential.end(), gridData.VPlane());
+
+    if (eigenValues.empty() || potentialChanged)
+    {
+        computeEigenStates();
+        eigenProjected = false;
+    }
+    if (!eigenProjected)
+        projectOntoEigenStates();
+
+    eigenTime += timeStep;
+
+    vector<cdouble> rotated(eigenValues.size());
+    for (size_t k = 0; k < eigenValues.size(); ++k)
+        rotated[k] = multiply(eigenCoefficients[k], polar(1.0, -eigenValues[k]*eigenTime));
+
+    ThreadPool::global().parallelFor(nx, [&](int x)
+    {
+        double* re = gridData.rePlane() + gridData.index(x, 0);
+        double* im = gridData.imPlane() + gridData.index(x, 0);
+        fill(re, re + ny, 0.0);
+        fill(im, im + ny, 0.0);
+
+        for (size_t k = 0; k < rotated.size(); ++k)
+        {
+            const double* state = eigenStates[k].data() + gridData.index(x, 0);
+            double cRe = rotated[k].real(), cIm = rotated[k].imag();
+            for (int y = 0; y < ny; ++y)
+            {
+                re[y] += cRe*state[y];
+                im[y] += cIm*state[y];
+            }
+        }
+    });
+}
+
+
+void Data::chebyshevQuantum(double timeStep)
+{
+    eigenProjected = false;
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    const int stride = gridData.getStride();
+    const size_t size = gridData.planeSize();
+
+    // a little slack: the series diverges quickly for eigenvalues outside of [-1, 1]
+    double lower, upper;
+    spectralBounds(lower, upper);
+    double center = 0.5*(upper + lower);
+    double halfWidth = 0.5*(upper - lower)*1.01 + EPSILON;
+    vector<double> J = besselSeries(halfWidth*timeStep, 1E-15);
+
+    if (chebyshevPlanes.size() != 8 || chebyshevPlanes[0].size() != size)
+        chebyshevPlanes.assign(8, AlignedVector<double>(size, 0.0));
+
+    // 0-1: T_k-1, 2-3: T_k, 4-5: T_k+1 (rotated through), 6-7: the sum
+    double* previous[2] = { chebyshevPlanes[0].data(), chebyshevPlanes[1].data() };
+    double* current[2] = { chebyshevPlanes[2].data(), chebyshevPlanes[3].data() };
+    double* next[2] = { chebyshevPlanes[4].data(), chebyshevPlanes[5].data() };
+    double* sum[2] = { chebyshevPlanes[6].data(), chebyshevPlanes[7].data() };
+
+    ThreadPool::global().parallelFor(nx, [&](int x)
+    {
+        int offset = gridData.index(x, 0);
+        copy(gridData.rePlane() + offset, gridData.rePlane() + offset + ny, current[0] + offset);
+        copy(gridData.imPlane() + offset, gridData.imPlane() + offset + ny, current[1] + offset);
+        for (int y = 0; y < ny; ++y)
+        {
+            sum[0][offset + y] = J[0]*current[0][offset + y];
+            sum[1][offset + y] = J[0]*current[1][offset + y];
+        }
+    });
+
+    for (size_t k = 1; k < J.size(); ++k)
+    {
+        // 2(-i)^k J_k
+        static const cdouble powers[] = { 1.0, cdouble(0.0, -1.0), -1.0, cdouble(0.0, 1.0) };
+        cdouble coefficient = 2.0*J[k]*powers[k%4];
+
+        // T_k+1 = 2((H - b)/a)T_k - T_k-1 (T_1 = ((H - b)/a)T_0), then added to the sum: all of it row by row
+        ThreadPool::global().parallelFor(nx, [&](int x)
+        {
+            int offset = gridData.index(x, 0);
+            const double* V = gridData.VPlane() + offset;
+            for (int part = 0; part < 2; ++part)
+            {
+                double* out = next[part] + offset;
+                const double* in = current[part] + offset;
+                const double* before = previous[part] + offset;
+                fill(out, out + ny, 0.0);
+                computeNextSegment(R, out, const_cast<double*>(in), V, ny, stride, dR, 1.0, stencilOrder);
+
+                if (k == 1)
+                    for (int y = 0; y < ny; ++y)
+                        out[y] = (out[y] - center*in[y])/halfWidth;
+                else
+                    for (int y = 0; y < ny; ++y)
+                        out[y] = 2.0*(out[y] - center*in[y])/halfWidth - before[y];
+            }
+
+            const double* re = next[0] + offset;
+            const double* im = next[1] + offset;
+            for (int y = 0; y < ny; ++y)
+            {
+                sum[0][offset + y] += coefficient.real()*re[y] - coefficient.imag()*im[y];
+                sum[1][offset + y] += coefficient.real()*im[y] + coefficient.imag()*re[y];
+            }
+        });
+
+        for (int part = 0; part < 2; ++part)
+        {
+            swap(previous[part], current[part]);
+            swap(current[part], next[part]);
+        }
+    }
+
+    // the shift by b comes back as a global phase
+    cdouble phase = polar(1.0, -center*timeStep);
+    ThreadPool::global().parallelFor(nx, [&](int x)
+    {
+        int offset = gridData.index(x, 0);
+        double* re = gridData.rePlane() + offset;
+        double* im = gridData.imPlane() + offset;
+        for (int y = 0; y < ny; ++y)
+        {
+            cdouble psi = multiply(phase, cdouble(sum[0][offset + y], sum[1][offset + y]));
+            re[y] = psi.real();
+            im[y] = psi.imag();
+        }
+    });
+}
+
+
+void Data::applyHamiltonian(const double* in, double* out)
+{
+    // the R sweep does out += dT*H*in: with out zeroed and dT = 1, that is H*in
+    const int ny = gridData.sizeY(), stride = gridData.getStride();
+    ThreadPool::global().parallelFor(gridData.sizeX(), [&](int x)
+    {
+        int offset = gridData.index(x, 0);
+        fill(out + offset, out + offset + ny, 0.0);
+        computeNextSegment(R, out + offset, const_cast<double*>(in) + offset, gridData.VPlane() + offset, ny, stride, dR, 1.0,
+                           stencilOrder);
+    });
+}
+
+
+void Data::spectralBounds(double& lower, double& upper)
+{
+    // the stencil laplacian is negative semi-definite, and the most negative it gets is for the checkerboard
+    // pattern (+-1 on alternating samples), which is also what gershgorin's bound gives
+    const double* coeffs = laplacianCoefficients(stencilOrder);
+    double kineticMax = -coeffs[0];
+    for (int k = 1; k <= stencilOrder/2; ++k)
+        kineticMax += 4.0*fabs(coeffs[k]);
+    kineticMax /= 2.0*dR*dR;
+
+    double VMin = numeric_limits<double>::max(), VMax = -numeric_limits<double>::max();
+    for (int x = 0; x < gridData.sizeX(); ++x)
+        for (int y = 0; y < gridData.sizeY(); ++y)
+        {
+            VMin = min(VMin, gridData.V(x, y));
+            VMax = max(VMax, gridData.V(x, y));
+        }
+
+    lower = VMin;
+    upper = VMax + kineticMax;
+}
+
+
+void Data::computeEigenStates()
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    const int stride = gridData.getStride();
+    const size_t size = gridData.planeSize();
+    const int wanted = min(numEigenStates, nx*ny);
+    const int maxIterations = min(EIGEN_MAX_ITERATIONS, nx*ny);
+    ThreadPool& pool = ThreadPool::global();
+
+    // plain lanczos on H would take thousands of iterations for the low end of the spectrum (which is tightly packed
+    // compared to its width): instead it runs on a chebyshev polynomial of H, which is bounded by 1 above an estimate
+    // of the wanted eigenvalues and grows quickly below it, so the wanted eigenvectors come out first
+    double lower, upper;
+    spectralBounds(lower, upper);
+
+    // weyl: -∇²/2 has about area*E/2π states below E
+    double area = (nx - 1)*dR*(ny - 1)*dR;
+    double cut = min(lower + 1.5*2.0*PI*wanted/area, 0.5*(lower + upper));
+    double center = 0.5*(cut + upper), halfWidth = 0.5*(upper - cut);
+
+    // enough for a gain of ~1e6 at the bottom of the spectrum: even, so that the wanted end is positive
+    double gainRate = acosh((center - lower)/halfWidth);
+    int degree = min(EIGEN_MAX_DEGREE, 2*int(ceil(0.5*acosh(1E6)/gainRate)));
+
+    // dot products and updates are split into chunks of whole rows (ghost cells are zero in every vector)
+    const int numChunks = (nx + ROWS_PER_PARCEL - 1)/ROWS_PER_PARCEL;
+    auto chunkBegin = [&](int chunk) { return size_t(chunk*ROWS_PER_PARCEL + GRID_HALO)*stride;};
+    auto chunkEnd = [&](int chunk) { return size_t(min(nx, (chunk + 1)*ROWS_PER_PARCEL) + GRID_HALO)*stride;};
+
+    // w = T_degree((H - center)/halfWidth)*v, with the three-term recurrence
+    AlignedVector<double> previous(size, 0.0), current(size, 0.0), next(size, 0.0);
+    auto filter = [&](const AlignedVector<double>& v, AlignedVector<double>& w)
+    {
+        previous = v;
+        applyHamiltonian(v.data(), current.data());
+        for (size_t n = 0; n < size; ++n)
+            current[n] = (current[n] - center*v[n])/halfWidth;
+
+        for (int k = 2; k <= degree; ++k)
+        {
+            applyHamiltonian(current.data(), next.data());
+            pool.parallelFor(numChunks, [&](int chunk)
+            {
+                for (size_t n = chunkBegin(chunk); n < chunkEnd(chunk); ++n)
+                    next[n] = 2.0*(next[n] - center*current[n])/halfWidth - previous[n];
+            });
+            swap(previous, current);
+            swap(current, next);
+        }
+        w = current;
+    };
+
+    // random start: has some of every eigenstate in it
+    vector<AlignedVector<double>> basis(1, AlignedVector<double>(size, 0.0));
+    mt19937 generator(1);
+    uniform_real_distribution<> distribution(-1.0, 1.0);
+    double norm = 0;
+    for (int x = 0; x < nx; ++x)
+        for (int y = 0; y < ny; ++y)
+        {
+            double value = distribution(generator);
+            basis[0][gridData.index(x, y)] = value;
+            norm += value*value;
+        }
+    for (size_t n = 0; n < size; ++n)
+        basis[0][n] /= sqrt(norm);
+
+    vector<double> alpha, beta, ritzValues, ritzVectors;
+    AlignedVector<double> w(size, 0.0);
+    vector<double> overlaps, partial(numChunks);
+    int converged = 0;
+
+    for (int j = 0; j < maxIterations; ++j)
+    {
+        filter(basis[j], w);
+
+        // full reorthogonalization against the whole basis (classical gram-schmidt, done twice),
+        // the first pass also takes care of the usual three-term recurrence
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            overlaps.assign(j + 1, 0.0);
+            pool.parallelFor(j + 1, [&](int i)
+            {
+                double dot = 0;
+                for (size_t n = 0; n < size; ++n)
+                    dot += w[n]*basis[i][n];
+                overlaps[i] = dot;
+            });
+            pool.parallelFor(numChunks, [&](int chunk)
+            {
+                for (int i = 0; i <= j; ++i)
+                    for (size_t n = chunkBegin(chunk); n < chunkEnd(chunk); ++n)
+                        w[n] -= overlaps[i]*basis[i][n];
+            });
+            if (pass == 0)
+                alpha.push_back(overlaps[j]);
+            else
+                alpha.back() += overlaps[j];
+        }
+
+        pool.parallelFor(numChunks, [&](int chunk)
+        {
+            double dot = 0;
+            for (size_t n = chunkBegin(chunk); n < chunkEnd(chunk); ++n)
+                dot += w[n]*w[n];
+            partial[chunk] = dot;
+        });
+        double b = sqrt(accumulate(partial.begin(), partial.end(), 0.0));
+
+        // every so often (and at the end), check how many of the largest ritz pairs have converged:
+        // the residual of a pair is |b*(last component of its eigenvector in the tridiagonal basis)|
+        const int m = j + 1;
+        bool last = m == maxIterations || b == 0.0;
+        if (last || (m >= wanted && m%10 == 0))
+        {
+            ritzValues = alpha;
+            vector<double> offDiagonal(beta);
+            tridiagonalEigen(ritzValues, offDiagonal, ritzVectors);
+
+            converged = 0;
+            while (converged < min(wanted, m) &&
+                   fabs(b*ritzVectors[size_t(m - 1)*m + m - 1 - converged]) <= EIGEN_TOLERANCE*ritzValues.back())
+                ++converged;
+
+            if (converged == wanted || last)
+                break;
+        }
+
+        beta.push_back(b);
+        basis.push_back(AlignedVector<double>(size));
+        for (size_t n = 0; n < size; ++n)
+            basis[j + 1][n] = w[n]/b;
+    }
+
+    // eigenstates = basis*(eigenvectors of the tridiagonal matrix), for the converged ones (the last columns)
+    const int m = int(alpha.size());
+    eigenStates.assign(converged, AlignedVector<double>(size, 0.0));
+    pool.parallelFor(numChunks, [&](int chunk)
+    {
+        for (int k = 0; k < converged; ++k)
+            for (int i = 0; i < m; ++i)
+            {
+                double weight = ritzVectors[size_t(i)*m + m - 1 - k];
+                for (size_t n = chunkBegin(chunk); n < chunkEnd(chunk); ++n)
+                    eigenStates[k][n] += weight*basis[i][n];
+            }
+    });
+
+    // the ritz values belong to the polynomial: the energies are the rayleigh quotients with H itself
+    eigenValues.assign(converged, 0.0);
+    for (int k = 0; k < converged; ++k)
+    {
+        applyHamiltonian(eigenStates[k].data(), w.data());
+        eigenValues[k] = inner_product(w.begin(), w.end(), eigenStates[k].begin(), 0.0);
+    }
+
+    eigenPotential.assign(gridData.VPlane(), gridData.VPlane() + size);
+    print("eigenstates: " + to_string(converged) + " of " + to_string(wanted) + " converged after "
+          + to_string(m) + " lanczos iterations (polynomial degree " + to_string(degree) + ")");
+}
+
+
+void Data::projectOntoEigenStates()
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    const size_t numStates = eigenStates.size();
+    eigenCoefficients.assign(numStates, 0.0);
+
+    ThreadPool::global().parallelFor(int(numStates), [&](int k)
+    {
+        double dotRe = 0, dotIm = 0;
+        for (int x = 0; x < nx; ++x)
+        {
+            const double* re = gridData.rePlane() + gridData.index(x, 0);
+            const double* im = gridData.imPlane() + gridData.index(x, 0);
+            const double* state = eigenStates[k].data() + gridData.index(x, 0);
+            for (int y = 0; y < ny; ++y)
+            {
+                dotRe += state[y]*re[y];
+                dotIm += state[y]*im[y];
+            }
+        }
+        eigenCoefficients[k] = cdouble(dotRe, dotIm);
+    });
+
+    // how much of the wavefunction the states can represent
+    double total = 0, kept = 0;
+    for (int x = 0; x < nx; ++x)
+        for (int y = 0; y < ny; ++y)
+            total += pow(gridData.reCur(x, y), 2) + pow(gridData.imCur(x, y), 2);
+    for (size_t k = 0; k < numStates; ++k)
+        kept += norm(eigenCoefficients[k]);
+    print("eigenstates: expansion keeps " + to_string(100.0*kept/max(total, EPSILON)) + "% of the norm");
+
+    eigenTime = 0;
+    eigenProjected = true;
+}
+
+
+// if any frame lag appears, it will primarily be because of this bottleneck
+void Data::verletQuantum(double timeStep)
+{
+    runSweeps(verletSweeps(timeStep, 1));
+}
+
+
+vector<Sweep> Data::verletSweeps(double timeStep, int numSteps)
+{
+    // the trailing R(dt/2) of a step merges with the leading R(dt/2) of the next:
+    // numSteps steps take 2*numSteps + 1 sweeps instead of 3*numSteps
+    vector<Sweep> sweeps;
+    for (int i = 0; i < numSteps; ++i)
+    {
+        appendSweep(sweeps, R, timeStep*0.5);
+        appendSweep(sweeps, I, timeStep);
+        appendSweep(sweeps, R, timeStep*0.5);
+    }
+    return sweeps;
+}
+
+
+vector<Sweep> Data::pefrlSweeps(double timeStep, int numSteps)
+{
+    // the outer ξ stages of consecutive steps merge the same way (into 2ξ)
+    vector<Sweep> sweeps;
+    for (int i = 0; i < numSteps; ++i)
+    {
+        // x = x + ξhv (38a)
+        appendSweep(sweeps, R, timeStep*squiggle);
+
+        // v = v + (1 − 2λ)hF(x)/2 (38b)
+        appendSweep(sweeps, I, timeStep*(1.0 - 2.0*lambda)/2.0);
+
+        // x = x + χhv (38c)
+        appendSweep(sweeps, R, timeStep*zeta);
+
+        // v = v + λhF(x) (38d)
+        appendSweep(sweeps, I, timeStep*lambda);
+
+        // x = x + (1 − 2(χ + ξ))hv (38e)
+        appendSweep(sweeps, R, timeStep*(1.0 - 2.0*(zeta+squiggle)));
+
+        // v = v + λhF(x) (38f)
+        appendSweep(sweeps, I, timeStep*lambda);
+
+        // x = x + χhv (38g)
+        appendSweep(sweeps, R, timeStep*zeta);
+
+        // v = v + (1 − 2λ)h*F(x)/2.0 (38h)
+        appendSweep(sweeps, I, timeStep*(1.0 - 2.0*lambda)/2.0);
+
+        // x = x + ξhv
+        appendSweep(sweeps, R, timeStep*squiggle);
+    }
+    return sweeps;
+}
+
+
+vector<Sweep> Data::integratorSweeps(double timeStep, int numSteps)
+{
+    return (integrator == PEFRL) ? pefrlSweeps(timeStep, numSteps) : verletSweeps(timeStep, numSteps);
+}
+
+
+void Data::runSweeps(const vector<Sweep>& sweeps)
+{
+    if (wallMasking && !wallMaskValid)
+        updateWallMask();
+
+    // the tiles of runSweepsBlocked always cover the whole grid
+    if (temporalBlocking)
+    {
+        sweepRegion = { 0, gridData.sizeX(), 0, gridData.sizeY() };
+        runSweepsBlocked(sweeps);
+        return;
+    }
+
+    // every sweep can carry the wavefunction one stencil radius further out
+    if (activeRegionTracking)
+    {
+        updateActiveRegion(stencilOrder/2*int(sweeps.size()));
+        sweepRegion = activeRegion;
+    }
+    else
+        sweepRegion = { 0, gridData.sizeX(), 0, gridData.sizeY() };
+
+    if (singlePrecision)
+    {
+        runSweepsSingle(sweeps);
+        return;
     }
 
-    if (preview)
-        setTile(samplesPerSide*samplesPerSide, anchor.x(), stretch.x(), anchor.y(), stretch.y(), 0, true);
+    if (fusedStepping)
+    {
+        runSweepsFused(sweeps);
+        return;
+    }
 
-    emit updateTileVbo();
+    // each of these is a parallel sweep over the whole grid, they are separated by barriers
+    for (size_t i = 0; i < sweeps.size(); ++i)
+        sweepGrid(sweeps[i].mode, sweeps[i].timeStep);
 }
 
 
-// helper functions to GLWidget::initData()
-void Data::initGridData()
+void Data::setRefinement(bool refine, double potentialJump, double waveJump)
 {
-    int samplesPerSide = sqrt(NUM_SAMPLES);
-    elapsedTime = 0.0;
+    refinement = refine;
+    refinePotentialJump = potentialJump;
+    refineWaveJump = waveJump;
+    patchesValid = false;
+    if (!refine)
+        patches.clear();
+}
 
-    for (int x = 0; x < samplesPerSide; ++x)
-    {
-        double xGLPos = indexToGL(x, samplesPerSide);
-        double xWorldPos = GLToWorld(xGLPos);
-        for (int y = 0; y < samplesPerSide; ++y)
-        {
-            // note that x by itself is an index
-            double yGLPos = indexToGL(y, samplesPerSide);
-            double yWorldPos = GLToWorld(yGLPos);
-            int index;
 
-            index = (x*samplesPerSide + y)*6;
-            cdouble cval = computeInitial(xWorldPos, yWorldPos, initialPacket);
+void Data::advanceBatch(PacketBatch& batch, int numFrames)
+{
+    vector<Sweep> sweeps = integratorSweeps(stepSize, simSpeed);
+    for (int frame = 0; frame < numFrames; ++frame)
+        batch.advance(sweeps);
+}
 
-            gridData[x][y].reBefore = cval.real();
-            gridData[x][y].reCur = gridData[x][y].reBefore;
-            gridData[x][y].imBefore = cval.imag();
-            gridData[x][y].imCur = gridData[x][y].imBefore;
-            gridData[x][y].x = xWorldPos;
-            gridData[x][y].y = yWorldPos;
-        }
+
+void Data::advanceDecomposition(DomainDecomposition& decomposition, int numFrames)
+{
+    vector<Sweep> sweeps = integratorSweeps(stepSize, simSpeed);
+    for (int frame = 0; frame < numFrames; ++frame)
+        decomposition.advance(sweeps);
+}
+
+
+string Data::setComputeBackend(ComputeBackend backend)
+{
+    if (backend == CPU_BACKEND)
+    {
+        fetchDeviceState();
+        deviceCurrent = false;
+        computeBackend = CPU_BACKEND;
+        return "all is well";
     }
 
-    particle.xCen = initialPacket.xCen;
-    particle.yCen = initialPacket.yCen;
-    particle.xVel = roundToPrecision(initialPacket.speed*cos(initialPacket.angle*DEG_TO_RAD), 2);
-    particle.yVel = roundToPrecision(initialPacket.speed*sin(initialPacket.angle*DEG_TO_RAD), 2);
+    // the device and the kernels are only looked for once, it is not going to show up later
+    if (!openCL)
+        openCL.reset(new OpenCLSolver());
+    if (!openCL->isReady())
+        return openCL->getStatus();
+
+    computeBackend = OPENCL_BACKEND;
+    return "all is well";
 }
 
 
-void Data::initGridVertices()
+void Data::fetchDeviceState()
 {
-    // note that not every point in gridVertices is represented by a sample :
-    // depending on the resolution setting, some vertices will be extrapolated
-    int sideLength = sqrt(numVerticesAfterScaling(NUM_SAMPLES, resolution));
+    if (hostCurrent)
+        return;
 
-    for (int x = 0; x < sideLength; ++x)
-        for (int y = 0; y < sideLength; ++y)
-        {
-            int index = sideLength*x + y;
-            gridVertices[index*6] = worldToGL(indexToWorld(x, dR/2.0));
-            gridVertices[index*6 + 1] = worldToGL(indexToWorld(y, dR/2.0));
-        }
+    // if this fails, gridData keeps the last wavefunction that it had
+    if (!openCL->download(gridData))
+        deviceFailed();
+    hostCurrent = true;
+    activeRegionValid = false;
 }
 
 
-void Data::initMeshVertices()
+void Data::dropDeviceState()
 {
-    // find appropriate shift
-    double enlargeFactor = 18.0;
-    double xStart = indexToGL(0, samplesPerSide);
-    double xStartEnlarged = xStart*enlargeFactor;
-    double dist = xStart - xStartEnlarged;
-    double gridDistEnlarged = enlargeFactor*abs(indexToGL(0, samplesPerSide) - indexToGL(1, samplesPerSide));
-    double indexEnlarged = floor(dist/gridDistEnlarged);
-    double xClosestEnlarged = xStartEnlarged + indexEnlarged*gridDistEnlarged;
-    double shift = xStart - xClosestEnlarged - worldToGL(0.5*dR);
+    fetchDeviceState();
+    deviceCurrent = false;
+}
+
+
+bool Data::deviceSweeps()
+{
+    return computeBackend == OPENCL_BACKEND && (integrator == VERLET || integrator == PEFRL) && !wallMasking &&
+           absorbingSamples == 0 && !refinement && !multirate;
+}
+
 
-    for (int x = 0; x < samplesPerSide; ++x)
+bool Data::runSweepsDevice(const vector<Sweep>& sweeps)
+{
+    if (!deviceCurrent)
     {
-        double xGLPos = indexToGL(x, samplesPerSide);
-        for (int y = 0; y < samplesPerSide; ++y)
+        if (!openCL->upload(gridData))
         {
-            // note that x by itself is an index
-            double yGLPos = indexToGL(y, samplesPerSide);
-            int index;
+            deviceFailed();
+            return false;
+        }
+        deviceCurrent = true;
+    }
 
-            index = (x*samplesPerSide + y)*VERTEX_SIZE;
+    if (!openCL->advance(sweeps, dR, stencilOrder))
+    {
+        // sweeps may have been enqueued before the one that failed: gridData is still from before the frame
+        deviceCurrent = false;
+        deviceFailed();
+        return false;
+    }
 
-            funcMeshVertices[index] = enlargeFactor*xGLPos + shift;
-            funcMeshVertices[index+1] = enlargeFactor*yGLPos + shift;
-            funcMeshVertices[index+2] = -0.01;
+    hostCurrent = false;
+    return true;
+}
 
-            // color needs to be interpolated depending on distance from center
-            Color cur;
-            double maxDist = 6.0;
-            double distArg = min(sqrt(pow(enlargeFactor*xGLPos + shift, 2.0) + pow(enlargeFactor*yGLPos + shift, 2.0))/maxDist, 1.0);
 
-            // interpolate to background color
-            cmap.getLinearInterpolated(distArg, Color(0.0, 0.0, 0.0), Color(0.16, 0.16, 0.2), cur);
-            funcMeshVertices[index+3] = cur.r;
-            funcMeshVertices[index+4] = cur.g;
-            funcMeshVertices[index+5] = cur.b;
-        }
+void Data::deviceFailed()
+{
+    if (computeBackend == OPENCL_BACKEND)
+        print("OpenCL: " + openCL->getStatus() + ", back to the CPU");
+    computeBackend = CPU_BACKEND;
+}
+
+
+void Data::setMultirate(bool enable, double potential)
+{
+    multirate = enable;
+    multiratePotential = potential;
+    patchesValid = false;
+    if (!enable)
+    {
+        stiffRegions.clear();
+        slowPotential.clear();
     }
 }
 
 
-void Data::initGridElementData()
+void Data::runSweepsRefined(const vector<Sweep>& sweeps, double frameTime)
 {
-    int k = 0;
-    int sideLength = sqrt(numVerticesAfterScaling(NUM_SAMPLES, resolution));
+    eigenProjected = false;
 
-    for (int i = 0; i < sideLength - 1; ++i)
-        for (int j = 0; j < sideLength - 1; ++j)
-        {
-            int index = sideLength*i + j;
+    // the whole frame on the device, if it can take it (see setComputeBackend)
+    if (deviceSweeps() && runSweepsDevice(sweeps))
+        return;
+    dropDeviceState();
 
-            // for element where i and j are both odd/even, use down-slant square configuration
-            // for element where i and j are different parity, use up-slant square configuration
-            if (i%2 != j%2)
-            {
-                // first triangle
-                gridElements[k*6] = index;
-                gridElements[k*6+1] = index + sideLength;
-                gridElements[k*6+2] = index + 1;
+    if (!refinement && !multirate)
+    {
+        runSweeps(sweeps);
+        return;
+    }
 
-                // second triangle
-                gridElements[k*6+3] = index + sideLength + 1;
-                gridElements[k*6+4] = index + 1;
-                gridElements[k*6+5] = index + sideLength;
-            }
-            else
-            {
-                // first triangle
-                gridElements[k*6] = index;
-                gridElements[k*6+1] = index + sideLength + 1;
-                gridElements[k*6+2] = index + 1;
+    // the fine samples of invalid patches are stale, they cannot be carried over
+    if (!patchesValid)
+    {
+        patches.clear();
+        regrid();
+    }
+    else if (++framesSinceRegrid >= AMR_REGRID_INTERVAL)
+        regrid();
 
-                // second triangle
-                gridElements[k*6+3] = index;
-                gridElements[k*6+4] = index + sideLength;
-                gridElements[k*6+5] = index + sideLength + 1;
-            }
-            ++k;
-        }
+    for (RefinedPatch& patch : patches)
+        sampleGhosts(patch, gridData, false);
+    if (stiffRegions.empty())
+        runSweeps(sweeps);
+    else
+        runSweepsMultirate(sweeps, frameTime);
+    for (RefinedPatch& patch : patches)
+        sampleGhosts(patch, gridData, true);
+
+    // the explicit solvers need dt ~ dR^2: AMR_RATIO^2 fine steps for every coarse one
+    int numSteps = max(1, int(rint(frameTime/stepSize)))*AMR_RATIO*AMR_RATIO;
+    vector<Sweep> stepSweeps = integratorSweeps(frameTime/numSteps, 1);
+    for (RefinedPatch& patch : patches)
+    {
+        advancePatch(patch, stepSweeps, numSteps, dR/AMR_RATIO, stencilOrder);
+        restrictPatch(patch, gridData);
+    }
 }
 
 
-void Data::advanceSimulation(QMutex* chicken, bool onlyClassical)
+void Data::regrid()
 {
-    // first time, apply all changes in velocity and position
-    if (elapsedTime == 0)
-        initGridData();
+    if (refinement)
+    {
+        vector<Region> regions = findRefinementRegions(gridData, refinePotentialJump, refineWaveJump);
+        vector<RefinedPatch> refined(regions.size());
+        for (size_t i = 0; i < regions.size(); ++i)
+            initPatch(refined[i], gridData, regions[i], patches);
+        patches.swap(refined);
+    }
 
-    Color color;
-    double refVal = 0;
-    Mode mode;
+    if (multirate)
+    {
+        stiffRegions = findStiffRegions(gridData, multiratePotential);
+        if (slowPotential.size() != gridData.planeSize())
+            allocateOwned(slowPotential, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());   // stands in for V
+        copy(gridData.VPlane(), gridData.VPlane() + gridData.planeSize(), slowPotential.begin());
+        for (const Region& region : stiffRegions)
+            for (int x = region.xStart; x < region.xEnd; ++x)
+                for (int y = region.yStart; y < region.yEnd; ++y)
+                    slowPotential[gridData.index(x, y)] = min(gridData.V(x, y), multiratePotential);
+    }
 
-    QFuture<void> supervisor = QtConcurrent::run(this, &Data::advanceSimulationClassical);
+    patchesValid = true;
+    framesSinceRegrid = 0;
+}
 
-    // run for a certain amount of timesteps (to speed up the animation)
-    // there is a limit to this depending on the CPU: frame lag will eventually appear if i is too great
-    for (int i = 0; i < (int)simSpeed; ++i)
-    {
-        elapsedTime += TIME_STEP;
 
-        if (!onlyClassical)
-            verletQuantum(TIME_STEP);
+void Data::runSweepsMultirate(const vector<Sweep>& sweeps, double frameTime)
+{
+    // unless the time step was set longer than that already
+    double slowStep = max(stepSize, STABILITY_FRACTION*2.0/stiffness(dR, stencilOrder, multiratePotential));
+    int numSteps = max(1, int(ceil(frameTime/slowStep - EPSILON)));
+    double step = frameTime/numSteps;
+    vector<Sweep> stepSweeps = integratorSweeps(step, 1);
+    if (stepSweeps.size()*numSteps >= sweeps.size())
+    {
+        runSweeps(sweeps);
+        return;
     }
 
-    // wait for classicalSimulation update to finish
-    while(!supervisor.isFinished()); // { cout << "classical simulation is being slow..." << endl; }
+    // read from the full potential, before it is swapped out
+    if (wallMasking && !wallMaskValid)
+        updateWallMask();
+
+    // the half rotations of consecutive steps merge
+    rotateStiffRegions(step*0.5);
+    for (int i = 0; i < numSteps; ++i)
+    {
+        gridData.swapPotentialPlane(slowPotential);
+        runSweeps(stepSweeps);
+        gridData.swapPotentialPlane(slowPotential);
+        rotateStiffRegions(i + 1 < numSteps ? step : step*0.5);
+    }
 }
 
 
-void Data::verletQuantumParcel(double timeStep, int id, int numParcels)
+void Data::rotateStiffRegions(double dT)
 {
-    updateGridParcel(R, timeStep*0.5, id, numParcels);
-    updateGridParcel(I, timeStep, id, numParcels);
-    updateGridParcel(R, timeStep*0.5, id, numParcels);
+    for (const Region& region : stiffRegions)
+        ThreadPool::global().parallelFor(region.xEnd - region.xStart, [&](int row)
+        {
+            int x = region.xStart + row;
+            for (int y = region.yStart; y < region.yEnd; ++y)
+            {
+                size_t i = gridData.index(x, y);
+                double angle = (gridData.VPlane()[i] - slowPotential[i])*dT;
+                if (angle == 0)
+                    continue;
+
+                double c = cos(angle), s = sin(angle);
+                double re = gridData.rePlane()[i], im = gridData.imPlane()[i];
+                gridData.rePlane()[i] = c*re + s*im;
+                gridData.imPlane()[i] = c*im - s*re;
+            }
+        });
 }
 
 
-void Data::updateGridParcel(Mode mode, double dT, int id, int numParcels)
+void Data::updateActiveRegion(int padding)
 {
-    int yStart, yEnd;
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    Region search = { 0, nx, 0, ny };
+    if (activeRegionValid)
+        search = { max(0, activeRegion.xStart - padding), min(nx, activeRegion.xEnd + padding),
+                   max(0, activeRegion.yStart - padding), min(ny, activeRegion.yEnd + padding) };
 
-    // careful, as total number of samples may not be divisible by numParcels
-    // we will a flexible amount of work for id = numParcels - 1
-    int width = gridData[0].size()/numParcels;
-    if (id != numParcels - 1)
-    {
-        yStart = id*width;
-        yEnd = (id+1)*width - 1;
-    }
-    else
+    // per row: the first and last sample above the threshold
+    int numRows = max(0, search.xEnd - search.xStart);
+    vector<int> first(numRows, ny), last(numRows, -1);
+    ThreadPool::global().parallelFor(numRows, [&](int row)
     {
-        yStart = id*width;
-        yEnd = gridData[0].size() - 1;
-    }
+        int x = search.xStart + row;
+        const double* re = gridData.rePlane() + gridData.index(x, 0);
+        const double* im = gridData.imPlane() + gridData.index(x, 0);
+        for (int y = search.yStart; y < search.yEnd; ++y)
+        {
+            if (re[y]*re[y] + im[y]*im[y] > ACTIVE_THRESHOLD)
+            {
+                first[row] = min(first[row], y);
+                last[row] = y;
+            }
+        }
+    });
 
-    if (mode == R)
+    Region found = { nx, -1, ny, -1 };
+    for (int row = 0; row < numRows; ++row)
     {
-        for (int x = 0; x < samplesPerSide; ++x)
-            for (int y = yStart; y <= yEnd; ++y)
-                gridData[x][y].reCur = ::computeNext(R, x, y, dR, dT, gridData);
+        if (last[row] < 0)
+            continue;
+        found.xStart = min(found.xStart, search.xStart + row);
+        found.xEnd = search.xStart + row + 1;
+        found.yStart = min(found.yStart, first[row]);
+        found.yEnd = max(found.yEnd, last[row] + 1);
     }
+
+    if (found.empty())
+        activeRegion = { 0, 0, 0, 0 };
     else
+        activeRegion = { max(0, found.xStart - padding), min(nx, found.xEnd + padding),
+                         max(0, found.yStart - padding), min(ny, found.yEnd + padding) };
+    activeRegionValid = true;
+}
+
+
+void Data::updateWallMask()
+{
+    const int nx = gridData.sizeX(), ny = gridData.sizeY();
+    openSpanStart.assign(nx + 1, 0);
+    openSpans.clear();
+
+    for (int x = 0; x < nx; ++x)
     {
-        for (int x = 0; x < samplesPerSide; ++x)
-            for (int y = yStart; y <= yEnd; ++y)
-                gridData[x][y].imCur = ::computeNext(I, x, y, dR, dT, gridData);
+        double* re = gridData.rePlane() + gridData.index(x, 0);
+        double* im = gridData.imPlane() + gridData.index(x, 0);
+        const double* V = gridData.VPlane() + gridData.index(x, 0);
+
+        int y = 0;
+        while (y < ny)
+        {
+            for (; y < ny && V[y] >= wallPotential; ++y)
+                re[y] = im[y] = 0.0;
+
+            int start = y;
+            while (y < ny && V[y] < wallPotential)
+                ++y;
+            if (y > start)
+                openSpans.push_back({ start, y });
+        }
+        openSpanStart[x + 1] = int(openSpans.size());
     }
+    wallMaskValid = true;
 }
 
 
-// a 4-th order symplectic algorithm
-void Data::pefrlQuantum(double timeStep)
+void Data::runSweepsFused(const vector<Sweep>& sweeps)
 {
-    // x = x + ξhv (38a)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*squiggle, gridData);
-
-    // v = v + (1 − 2λ)hF(x)/2 (38b)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].imCur = ::computeNext(I, x, y, dR, timeStep*(1.0 - 2.0*lambda)/2.0, gridData);
+    ThreadPool& pool = ThreadPool::global();
 
-    // x = x + χhv (38c)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*zeta, gridData);
+    // a single parallel region for all of the sweeps:
+    // every worker keeps the same block of rows throughout (so it stays in that core's cache),
+    // and only waits for its neighbours at the end of each sweep (the stencil reaches into their rows)
+    pool.runRegion([&](int worker, int numWorkers)
+    {
+        for (size_t i = 0; i < sweeps.size(); ++i)
+        {
+            updateGridParcel(sweeps[i].mode, sweeps[i].timeStep, worker, numWorkers);
+            pool.sync();
+        }
+    });
+}
 
-    // v = v + λhF(x) (38d)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].imCur = ::computeNext(I, x, y, dR, timeStep*lambda, gridData);
 
-    // x = x + (1 − 2(χ + ξ))hv (38e)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*(1.0 - 2.0*(zeta+squiggle)), gridData);
+void Data::runSweepsSingle(const vector<Sweep>& sweeps)
+{
+    const Region& region = sweepRegion;
+    if (region.empty())
+        return;
 
-    // v = v + λhF(x) (38f)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].imCur = ::computeNext(I, x, y, dR, timeStep*lambda, gridData);
+    if (reSingle.size() != gridData.planeSize())
+    {
+        // zeroed: the ghost cells are never written to after this
+        allocateOwned(reSingle, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());
+        allocateOwned(imSingle, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());
+        allocateOwned(VSingle, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());
+    }
 
-    // x = x + χhv (38g)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*zeta, gridData);
+    // the stencil reads up to GRID_HALO rows and columns outside of the region: those are copied too
+    const int yStart = region.yStart - GRID_HALO, yEnd = region.yEnd + GRID_HALO;
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(region.xEnd - region.xStart + 2*GRID_HALO, [&](int row)
+    {
+        int x = region.xStart - GRID_HALO + row;
+        size_t begin = gridData.index(x, yStart), end = gridData.index(x, yEnd);
+        for (size_t i = begin; i < end; ++i)
+        {
+            reSingle[i] = float(gridData.rePlane()[i]);
+            imSingle[i] = float(gridData.imPlane()[i]);
+            VSingle[i] = float(gridData.VPlane()[i]);
+        }
+    });
 
-    // v = v + (1 − 2λ)h*F(x)/2.0 (38h)
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].imCur = ::computeNext(I, x, y, dR, timeStep*(1.0 - 2.0*lambda)/2.0, gridData);
+    if (fusedStepping)
+        runSweepsFused(sweeps);
+    else
+        for (size_t i = 0; i < sweeps.size(); ++i)
+            sweepGrid(sweeps[i].mode, sweeps[i].timeStep);
 
-    // x = x + ξhv
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*squiggle, gridData);
+    // only the region itself was swept, the samples around it have to keep their full precision
+    pool.parallelFor(region.xEnd - region.xStart, [&](int row)
+    {
+        int x = region.xStart + row;
+        size_t begin = gridData.index(x, region.yStart), end = gridData.index(x, region.yEnd);
+        for (size_t i = begin; i < end; ++i)
+        {
+            gridData.rePlane()[i] = reSingle[i];
+            gridData.imPlane()[i] = imSingle[i];
+        }
+    });
 }
 
 
-// if any frame lag appears, it will primarily be because of this bottleneck
-void Data::verletQuantum(double timeStep)
+void Data::reportPrecisionDrift(int numSteps)
 {
-    /*
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*0.5, gridData);
-
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].imCur = ::computeNext(I, x, y, dR, timeStep, gridData);
+    fetchDeviceState();   // the CPU sweeps are compared, from the current state (which they leave as it was)
+    vector<Sweep> sweeps = integratorSweeps(stepSize, numSteps);
+    const size_t size = gridData.planeSize();
+    AlignedVector<double> reSaved(gridData.rePlane(), gridData.rePlane() + size);
+    AlignedVector<double> imSaved(gridData.imPlane(), gridData.imPlane() + size);
+    bool wasSingle = singlePrecision, wasBlocking = temporalBlocking;
+    temporalBlocking = false;
 
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
-            gridData[x][y].reCur = ::computeNext(R, x, y, dR, timeStep*0.5, gridData);
-    */
-
-    // to make things any faster, use gpGPU (openCL)
-    QFuture<void> t = QtConcurrent::run(this, &Data::updateGridParcel, R, timeStep*0.5, 0, 2);
-    updateGridParcel(R, timeStep*0.5, 1, 2);
-    while (t.isRunning());
+    auto run = [&](bool single, AlignedVector<double>& re, AlignedVector<double>& im)
+    {
+        re = reSaved;
+        im = imSaved;
+        gridData.swapWavePlanes(re, im);
+        singlePrecision = single;
+        activeRegionValid = false;
+        runSweeps(sweeps);
+        gridData.swapWavePlanes(re, im);
+    };
+
+    AlignedVector<double> reDouble, imDouble, reFloat, imFloat;
+    run(false, reDouble, imDouble);
+    run(true, reFloat, imFloat);
+
+    // every sum in double, whichever precision the sweeps were done in
+    double maxDiff = 0, diffSquared = 0, normDouble = 0, normFloat = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        double dRe = reFloat[i] - reDouble[i], dIm = imFloat[i] - imDouble[i];
+        maxDiff = max(maxDiff, sqrt(dRe*dRe + dIm*dIm));
+        diffSquared += dRe*dRe + dIm*dIm;
+        normDouble += reDouble[i]*reDouble[i] + imDouble[i]*imDouble[i];
+        normFloat += reFloat[i]*reFloat[i] + imFloat[i]*imFloat[i];
+    }
+    normDouble *= dR*dR;
+    normFloat *= dR*dR;
 
-    t = QtConcurrent::run(this, &Data::updateGridParcel, I, timeStep, 0, 2);
-    updateGridParcel(I, timeStep, 1, 2);
-    while (t.isRunning());
+    ostringstream report;
+    report << "single vs double precision after " << numSteps << " steps: max |dψ| = " << maxDiff
+           << ", relative L2 = " << sqrt(diffSquared*dR*dR/normDouble)
+           << setprecision(12) << ", norm = " << normFloat << " (double: " << normDouble << ")";
+    print(report.str());
 
-    t = QtConcurrent::run(this, &Data::updateGridParcel, R, timeStep*0.5, 0, 2);
-    updateGridParcel(R, timeStep*0.5, 1, 2);
-    while (t.isRunning());
+    gridData.swapWavePlanes(reSaved, imSaved);
+    singlePrecision = wasSingle;
+    temporalBlocking = wasBlocking;
+    activeRegionValid = false;
 }
 
 
@@ -1040,17 +2326,38 @@ void Data::updateGrid(char drawMode, bool flat, char probsCmap)
     // only have to worry about centers, preview for arrow is handled by setArrow
     double totDif = fabs(initialPacket.xCen - initialPacketSaved.xCen) + fabs(initialPacket.yCen - initialPacketSaved.yCen);
     bool preview = totDif >= EPSILON;
-    int sideLength = sqrt(numVerticesAfterScaling(NUM_SAMPLES, resolution));
+    int verticesX = verticesAfterScaling(samplesX, resolution);
+    int sideLength = verticesAfterScaling(samplesY, resolution);   // length of a row of vertices
     int sideScale = pow(2.0, resolution-1);
 
-    for (int x = 0; x < samplesPerSide; ++x)
-        for (int y = 0; y < samplesPerSide; ++y)
+    // the samples' values and colours are mapped on the device if it is ahead of gridData (see setComputeBackend)
+    bool onDevice = false;
+    if (!hostCurrent)
+    {
+        char cmapCode = (drawMode == 'P') ? ((probsCmap == 'H') ? 'h' : 'j') : 'c';
+        double low = (drawMode == 'P') ? 0.0 : -2.0*jetMax, high = (drawMode == 'P') ? jetMax : 2.0*jetMax;
+        onDevice = openCL->colorSamples(drawMode, cmapCode, low, high, preview, deviceValues, deviceColors);
+        if (!onDevice)
+            fetchDeviceState();
+    }
+
+    for (int x = 0; x < int(samplesX); ++x)
+    {
+        const double* re = gridData.rePlane() + gridData.index(x, 0);
+        const double* im = gridData.imPlane() + gridData.index(x, 0);
+
+        for (int y = 0; y < int(samplesY); ++y)
         {
             double refVal = 0;
-            if (drawMode == 'P')
+            if (onDevice)
             {
-                refVal = pow(gridData[x][y].imCur,2.0) + pow(gridData[x][y].reCur,2.0);
-                gridData[x][y].refVal = refVal;
+                size_t sample = size_t(x)*samplesY + y;
+                refVal = deviceValues[sample];
+                color = Color(deviceColors[3*sample], deviceColors[3*sample + 1], deviceColors[3*sample + 2]);
+            }
+            else if (drawMode == 'P')
+            {
+                refVal = im[y]*im[y] + re[y]*re[y];
 
                 if (probsCmap == 'H')
                     cmap.computeColor(refVal, color, 0, jetMax, 'h');
@@ -1059,17 +2366,19 @@ void Data::updateGrid(char drawMode, bool flat, char probsCmap)
             }
             else if (drawMode == 'R')
             {
-                refVal = gridData[x][y].reCur;
+                refVal = re[y];
                 cmap.computeColor(refVal, color, -2.0*jetMax, 2.0*jetMax, 'c');
             }
             else if (drawMode == 'I')
             {
-                refVal = gridData[x][y].imCur;
+                refVal = im[y];
                 cmap.computeColor(refVal, color, -2.0*jetMax, 2.0*jetMax, 'c');
             }
 
+            gridData.refVal(x, y) = refVal;   // what interpolateBicubic goes by
+
             int index = sideScale*(sideLength*x + y);
-            if (preview)
+            if (preview && !onDevice)
                 color = color.highlight();
 
             gridVertices[index*6 + 2] = refVal;
@@ -1077,12 +2386,13 @@ void Data::updateGrid(char drawMode, bool flat, char probsCmap)
             gridVertices[index*6 + 4] = color.g;
             gridVertices[index*6 + 5] = color.b;
         }
+    }
 
     interpolateBicubic(drawMode, probsCmap, preview);
 
     // flatten, if required (we cannot do this any earlier, as extrapolation needed the data)
     if (flat)
-        for (int i = 0; i < sideLength; ++i)
+        for (int i = 0; i < verticesX; ++i)
             for (int j = 0; j < sideLength; ++j)
             {
                 int index = i*sideLength + j;
@@ -1096,12 +2406,11 @@ void Data::updateGrid(char drawMode, bool flat, char probsCmap)
 void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
 {
     Color color;
-    int sideLength = sqrt(numVerticesAfterScaling(NUM_SAMPLES, resolution));
-    int sideScale = pow(2.0, resolution-1);
+    int sideLength = verticesAfterScaling(samplesY, resolution);   // length of a row of vertices
     QVector<QVector<double>> values = {{0,0,0,0},{0,0,0,0},{0,0,0,0},{0,0,0,0}};
 
-    for (int i = 0; i < gridData.size()-1; ++i)
-        for (int j = 0; j < gridData[0].size()-1; ++j)
+    for (int i = 0; i < gridData.sizeX()-1; ++i)
+        for (int j = 0; j < gridData.sizeY()-1; ++j)
         {
             // the current vertex that we are is f1,1 : in 1D our interpolant requires f0, f1, f2, f3
             // accordingly, in 2D we need a 4x4 array of values.
@@ -1109,15 +2418,8 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
             for (int k = i-1; k <= i + 2; ++k)
                 for (int l = j-1; l <= j + 2; ++l)
                 {
-                    if (!(k < 0 || k >= gridData.size() || l < 0 || l >= gridData.size()))
-                    {
-                        if (drawMode == 'P')
-                            values[k - i + 1][l - j + 1] = gridData[k][l].refVal;
-                        else if (drawMode == 'R')
-                            values[k - i + 1][l - j + 1] = gridData[k][l].reCur;
-                        else
-                            values[k - i + 1][l - j + 1] = gridData[k][l].imCur;
-                    }
+                    if (!(k < 0 || k >= gridData.sizeX() || l < 0 || l >= gridData.sizeY()))
+                        values[k - i + 1][l - j + 1] = gridData.refVal(k, l);   // |ψ|², re or im, as drawn
                     else
                     {
                         values[k - i + 1][l - j + 1] = 0.0;
@@ -1131,9 +2433,9 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
             double rightVal, botVal;
 
             // extra points needed at the edges
-            if (i == gridData.size() - 2)
+            if (i == gridData.sizeX() - 2)
                 rightVal = interpolateBicubic2D(values, 1.0, 0.5);
-            if (j == gridData[0].size() - 2)
+            if (j == gridData.sizeY() - 2)
                 botVal = interpolateBicubic2D(values, 0.5, 1.0);
 
             // plant these values into the appropriate indices in our vertex data
@@ -1149,9 +2451,9 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
             gridVertices[topSideIndex*6 + 2] = topVal;
             gridVertices[centerIndex*6 + 2] = centerVal;
 
-            if (i == gridData[0].size() - 2)
+            if (i == gridData.sizeX() - 2)
                 gridVertices[rightIndex*6 + 2] = rightVal;
-            if (j == gridData.size() - 2)
+            if (j == gridData.sizeY() - 2)
                 gridVertices[botIndex*6 + 2] = botVal;
 
             char cmapCode;
@@ -1193,7 +2495,7 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
             gridVertices[centerIndex*6 + 4] = color.g;
             gridVertices[centerIndex*6 + 5] = color.b;
 
-            if (i == gridData.size() - 2)
+            if (i == gridData.sizeX() - 2)
             {
                 cmap.computeColor(rightVal, color, min, max, cmapCode);
                 if (preview)
@@ -1203,7 +2505,7 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
                 gridVertices[rightIndex*6 + 5] = color.b;
             }
 
-            if (j == gridData[0].size() - 2)
+            if (j == gridData.sizeY() - 2)
             {
                 cmap.computeColor(botVal, color, min, max, cmapCode);
                 if (preview)
@@ -1220,14 +2522,15 @@ void Data::interpolateBicubic(char drawMode, char probsCmap, bool preview)
 void Data::interpolateBilinear(char drawMode, char probsCmap, bool preview)
 {
     Color color;
-    int sideLength = sqrt(numVerticesAfterScaling(NUM_SAMPLES, resolution));
+    int verticesX = verticesAfterScaling(samplesX, resolution);
+    int sideLength = verticesAfterScaling(samplesY, resolution);   // length of a row of vertices
     int sideScale = pow(2.0, resolution-1);
 
     // NOTE: has not been upgraded to work with any resolution other than 2x (pixel density)
     // fill in the extrapolated points
     // can only extrapolate in stages
     int gridDataElement = 0;
-    for (int i = 0; i < sideLength; ++i)
+    for (int i = 0; i < verticesX; ++i)
         for (int j = 0; j < sideLength; ++j)
         {
             // the points that we already marked, or are as of now indeterminate points
@@ -1281,8 +2584,8 @@ void Data::interpolateBilinear(char drawMode, char probsCmap, bool preview)
         }
 
     // extrapolate to the vertices along each hypotenuse
-    for (int i = 0; i < samplesPerSide - 1; ++i)
-        for (int j = 0; j < samplesPerSide - 1; ++j)
+    for (int i = 0; i < int(samplesX) - 1; ++i)
+        for (int j = 0; j < int(samplesY) - 1; ++j)
         {
             int index = sideScale*(sideLength*i + j) + 1 + sideLength;
             int topIndex = index - 1;
@@ -1346,21 +2649,21 @@ void Data::setTile(int tileNum, int _x1, int _x2, int _y1, int _y2, double pot,
             double height;
             double xoffset, yoffset;
             if (i < 4) // bottom 4
-                height = gridData[indices[i][0]][indices[i][1]].V;
+                height = gridData.V(indices[i][0], indices[i][1]);
             else       // top 4
-                height = gridData[indices[i%4][0]][indices[i%4][1]].VPreview;
+                height = gridData.VPreview(indices[i%4][0], indices[i%4][1]);
 
             if (i%4 == 0 || i%4 == 3)
-                xoffset = -dR/SIDE_LENGTH;
+                xoffset = -dR/worldSideLength();
             else
-                xoffset = dR/SIDE_LENGTH;
+                xoffset = dR/worldSideLength();
             if (i%4 == 0 || i%4 == 1)
-                yoffset = -dR/SIDE_LENGTH;
+                yoffset = -dR/worldSideLength();
             else
-                yoffset = dR/SIDE_LENGTH;
+                yoffset = dR/worldSideLength();
 
-            tileVertices[currentIndexVertex + i*6] = indexToGL(indices[i%4][0], samplesPerSide)+xoffset;
-            tileVertices[currentIndexVertex + i*6 + 1] = indexToGL(indices[i%4][1], samplesPerSide)+yoffset;
+            tileVertices[currentIndexVertex + i*6] = worldToGL(gridData.xCoord(indices[i%4][0]))+xoffset;
+            tileVertices[currentIndexVertex + i*6 + 1] = worldToGL(gridData.yCoord(indices[i%4][1]))+yoffset;
             tileVertices[currentIndexVertex + i*6 + 2] = potentialToGL(height);
             tileVertices[currentIndexVertex + i*6 + 3] = 1.0;
             tileVertices[currentIndexVertex + i*6 + 4] = 0;
@@ -1374,16 +2677,16 @@ void Data::setTile(int tileNum, int _x1, int _x2, int _y1, int _y2, double pot,
             double xoffset, yoffset;
 
             if (i%4 == 0 || i%4 == 3)
-                xoffset = -dR/SIDE_LENGTH;
+                xoffset = -dR/worldSideLength();
             else
-                xoffset = dR/SIDE_LENGTH;
+                xoffset = dR/worldSideLength();
             if (i%4 == 0 || i%4 == 1)
-                yoffset = -dR/SIDE_LENGTH;
+                yoffset = -dR/worldSideLength();
             else
-                yoffset = dR/SIDE_LENGTH;
+                yoffset = dR/worldSideLength();
 
-            tileVertices[currentIndexVertex + i*6] = indexToGL(_x1,samplesPerSide)+xoffset;//indexToGL(indices[i%4][0], samplesPerSide)+xoffset;
-            tileVertices[currentIndexVertex + i*6 + 1] = indexToGL(_y1,samplesPerSide)+yoffset;//indexToGL(indices[i%4][1], samplesPerSide)+yoffset;
+            tileVertices[currentIndexVertex + i*6] = worldToGL(gridData.xCoord(_x1))+xoffset;
+            tileVertices[currentIndexVertex + i*6 + 1] = worldToGL(gridData.yCoord(_y1))+yoffset;
             tileVertices[currentIndexVertex + i*6 + 2] = potentialToGL(pot);
             tileVertices[currentIndexVertex + i*6 + 3] = cmap.potentialToColor(pot);
             tileVertices[currentIndexVertex + i*6 + 4] = cmap.potentialToColor(pot);
@@ -1406,16 +2709,16 @@ void Data::setNet(int x1, int x2, int y1, int y2, double _height)
             height = _height;
 
         if (i%4 == 0 || i%4 == 3)
-            xoffset = -dR/SIDE_LENGTH;
+            xoffset = -dR/worldSideLength();
         else
-            xoffset = dR/SIDE_LENGTH;
+            xoffset = dR/worldSideLength();
         if (i%4 == 0 || i%4 == 1)
-            yoffset = -dR/SIDE_LENGTH;
+            yoffset = -dR/worldSideLength();
         else
-            yoffset = dR/SIDE_LENGTH;
+            yoffset = dR/worldSideLength();
 
-        netVertices[i*6] = indexToGL(indices[i%4][0], samplesPerSide)+xoffset;
-        netVertices[i*6 + 1] = indexToGL(indices[i%4][1], samplesPerSide)+yoffset;
+        netVertices[i*6] = worldToGL(gridData.xCoord(indices[i%4][0]))+xoffset;
+        netVertices[i*6 + 1] = worldToGL(gridData.yCoord(indices[i%4][1]))+yoffset;
         netVertices[i*6 + 2] = potentialToGL(height);
         netVertices[i*6 + 3] = 0.0;
         netVertices[i*6 + 4] = 1.0;
@@ -1427,10 +2730,10 @@ void Data::setNet(int x1, int x2, int y1, int y2, double _height)
 void Data::initTileVertexData()
 {
     tileNum = 0;
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            setTile(tileNum, i, i, j, j, gridData[i][j].VPreview, false);
+            setTile(tileNum, i, i, j, j, gridData.VPreview(i, j), false);
             ++tileNum;
         }
 }
@@ -1462,21 +2765,21 @@ void Data::initFuncMeshElementData()
     int spacing = 1;
 
     // for each x, connect along y-axis
-    for (int i = 0; i < gridData.size(); i += spacing)
-        for (int j = 0; j < gridData[0].size() - 1; ++j)
+    for (int i = 0; i < gridData.sizeX(); i += spacing)
+        for (int j = 0; j < gridData.sizeY() - 1; ++j)
         {
-            int index = i*gridData.size() + j;
+            int index = i*gridData.sizeY() + j;
             funcMeshElements[curElement++] = index;
             funcMeshElements[curElement++] = index + 1;
         }
 
     // connect along x-axis
-    for (int j = 0; j < gridData[0].size(); j += spacing)
-        for (int i = 0; i < gridData.size() - 1; ++i)
+    for (int j = 0; j < gridData.sizeY(); j += spacing)
+        for (int i = 0; i < gridData.sizeX() - 1; ++i)
         {
-            int index = i*gridData.size() + j;
+            int index = i*gridData.sizeY() + j;
             funcMeshElements[curElement++] = index;
-            funcMeshElements[curElement++] = index + gridData.size();
+            funcMeshElements[curElement++] = index + gridData.sizeY();
         }
 }
 
@@ -1659,18 +2962,18 @@ QPoint Data::searchProximity(const QPoint &start, int target, int maxRadius)
         int x = cur.x();
         int y = cur.y();
 
-        if (!(x < 0 || x >= gridData.size() || y < 0 || y >= gridData[0].size()))
-            if (rint(gridData[x][y].V) == target)
+        if (!(x < 0 || x >= gridData.sizeX() || y < 0 || y >= gridData.sizeY()))
+            if (rint(gridData.V(x, y)) == target)
                 return cur;
 
         for (int i = 0; i < 4; ++i)
         {
             int newX = x + moves[i][0];
             int newY = y + moves[i][1];
-            int index = newX*gridData.size() + newY; // uniqueness check
+            int index = newX*gridData.sizeY() + newY; // uniqueness check
 
             // check for bounds, radius, and uniqueness
-            if (newX >= 0 && newX < gridData.size() && newY >= 0 && newY < gridData[0].size())
+            if (newX >= 0 && newX < gridData.sizeX() && newY >= 0 && newY < gridData.sizeY())
                 if (pow(newX-start.x(), 2.0) + pow(newY - start.y(), 2.0) < maxRadius*maxRadius)
                     if (onList.find(index) == onList.end())
                     {
@@ -1709,17 +3012,17 @@ QPoint Data::findClosestIndices(const QVector3D &start, const QVector3D &directi
         y = GLToWorld(a*direction[1] + start[1]);
 
         // normalize the coordinates to be within bounds
-        x = max(x , -SIDE_LENGTH/2.0);
-        x = min(x , SIDE_LENGTH/2.0);
-        y = max(y, -SIDE_LENGTH/2.0);
-        y = min(y, SIDE_LENGTH/2.0);
+        x = max(x , -sideLengthX/2.0);
+        x = min(x , sideLengthX/2.0);
+        y = max(y, -sideLengthY/2.0);
+        y = min(y, sideLengthY/2.0);
 
         if (h == 0)
             flatIntersect = {float(x), float(y), 0.0};
 
         // find the closest indices (similar to procedure used in findClosestIndicesFlat)
-        xIndex = rint((x + SIDE_LENGTH/2.0)/dR);
-        yIndex = rint((y + SIDE_LENGTH/2.0)/dR);
+        xIndex = rint((x + sideLengthX/2.0)/dR);
+        yIndex = rint((y + sideLengthY/2.0)/dR);
 
         // do a search within the proximity for grid points with this potential
         QPoint candidate = searchProximity(QPoint(xIndex, yIndex), h, maxIndexDist);
@@ -1750,9 +3053,9 @@ QPoint Data::findClosestIndices(const QVector3D &start, const QVector3D &directi
             list<QPoint> within;
             for (list<QPoint>::iterator it = candidates.begin(); it != candidates.end(); ++it)
             {
-                float x = gridData[it->x()][it->y()].x;
-                float y = gridData[it->x()][it->y()].y;
-                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData[it->x()][it->y()].V)))};
+                float x = gridData.xCoord(it->x());
+                float y = gridData.yCoord(it->y());
+                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData.V(it->x(), it->y()))))};
                 float distance = candidate.distanceToLine(startWorld, dirWorld);
 
                 if (distance <= threshold)
@@ -1763,9 +3066,9 @@ QPoint Data::findClosestIndices(const QVector3D &start, const QVector3D &directi
             double minDist = numeric_limits<double>::max();
             for (list<QPoint>::iterator it = within.begin(); it != within.end(); ++it)
             {
-                float x = gridData[it->x()][it->y()].x;
-                float y = gridData[it->x()][it->y()].y;
-                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData[it->x()][it->y()].V)))};
+                float x = gridData.xCoord(it->x());
+                float y = gridData.yCoord(it->y());
+                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData.V(it->x(), it->y()))))};
                 float distance = candidate.distanceToPoint(startWorld);
 
                 if (distance < minDist)
@@ -1786,9 +3089,9 @@ QPoint Data::findClosestIndices(const QVector3D &start, const QVector3D &directi
             double minDist = numeric_limits<double>::max();
             for (list<QPoint>::iterator it = candidates.begin(); it != candidates.end(); ++it)
             {
-                float x = gridData[it->x()][it->y()].x;
-                float y = gridData[it->x()][it->y()].y;
-                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData[it->x()][it->y()].V)))};
+                float x = gridData.xCoord(it->x());
+                float y = gridData.yCoord(it->y());
+                QVector3D candidate = {x, y, float(potentialToWorld(float(gridData.V(it->x(), it->y()))))};
                 float distance = candidate.distanceToPoint(startWorld);
 
                 if (distance < minDist)
@@ -1802,8 +3105,8 @@ QPoint Data::findClosestIndices(const QVector3D &start, const QVector3D &directi
         // adjust according to spacing rules
         int adjustedX = spacing*rint(float(closest.x())/float(spacing));
         int adjustedY = spacing*rint(float(closest.y())/float(spacing));
-        int endX = spacing*floor(float(gridData.size()-1)/float(spacing));
-        int endY = spacing*floor(float(gridData[0].size()-1)/float(spacing));
+        int endX = spacing*floor(float(gridData.sizeX()-1)/float(spacing));
+        int endY = spacing*floor(float(gridData.sizeY()-1)/float(spacing));
 
         adjustedX = min(adjustedX, endX);
         adjustedX = max(adjustedX, 0);
@@ -1830,10 +3133,10 @@ QPoint Data::findClosestIndicesFlat(const QVector3D &coords, int spacingInt, boo
         converted = coords;
 
     double spacing = spacingInt;
-    int xIndex = spacing * rint ((converted.x() + SIDE_LENGTH/2.0)/(spacing*dR));
-    int yIndex = spacing * rint ((converted.y() + SIDE_LENGTH/2.0)/(spacing*dR));
-    int endX = spacing*floor(float(gridData.size()-1)/float(spacing));
-    int endY = spacing*floor(float(gridData[0].size()-1)/float(spacing));
+    int xIndex = spacing * rint ((converted.x() + sideLengthX/2.0)/(spacing*dR));
+    int yIndex = spacing * rint ((converted.y() + sideLengthY/2.0)/(spacing*dR));
+    int endX = spacing*floor(float(gridData.sizeX()-1)/float(spacing));
+    int endY = spacing*floor(float(gridData.sizeY()-1)/float(spacing));
 
     xIndex = max(0, xIndex);
     xIndex = min(xIndex, endX);
@@ -1860,10 +3163,19 @@ QPoint Data::findClosestIndicesFlat(const QVector3D &start, const QVector3D &dir
 double Data::getProbability(int x1, int x2, int y1, int y2)
 {
     double sum = 0;
+    if (!hostCurrent && openCL->sumProbability(x1, x2, y1, y2, sum))
+        return sum*dR*dR;
+    fetchDeviceState();   // only does anything if the device failed
+    sum = 0;
+    int yStart = min(y1, y2), yEnd = max(y1, y2);
 
     for (int i = min(x1,x2); i <= max(x1, x2); ++i)
-        for (int j = min(y1,y2); j <= max(y1,y2); ++j)
-            sum += pow(gridData[i][j].reCur,2) + pow(gridData[i][j].imCur,2);
+    {
+        const double* re = gridData.rePlane() + gridData.index(i, 0);
+        const double* im = gridData.imPlane() + gridData.index(i, 0);
+        for (int j = yStart; j <= yEnd; ++j)
+            sum += re[j]*re[j] + im[j]*im[j];
+    }
 
     double factor = dR*dR;
     return sum*factor;
@@ -1872,17 +3184,17 @@ double Data::getProbability(int x1, int x2, int y1, int y2)
 
 bool Data::findRectangle(Block& rect, int x, int y, bool preview)
 {
-    if (gridData[x][y].covered || (gridData[x][y].V == 0 && !preview))
+    if (gridData.covered(x, y) || (gridData.V(x, y) == 0 && !preview))
         return false;
-    if (gridData[x][y].covered || (gridData[x][y].VPreview == 0 && preview))
+    if (gridData.covered(x, y) || (gridData.VPreview(x, y) == 0 && preview))
         return false;
 
     double refPotential;
 
     if (!preview)
-        refPotential = gridData[x][y].V;
+        refPotential = gridData.V(x, y);
     else
-        refPotential = gridData[x][y].VPreview;
+        refPotential = gridData.VPreview(x, y);
 
     int rIndex = x;
     int dIndex = y + 1;
@@ -1890,27 +3202,27 @@ bool Data::findRectangle(Block& rect, int x, int y, bool preview)
     // go as far to the right as possible
     if (!preview)
     {
-        while (rIndex < gridData.size() && gridData[rIndex][y].V == refPotential && !gridData[rIndex][y].covered)
+        while (rIndex < gridData.sizeX() && gridData.V(rIndex, y) == refPotential && !gridData.covered(rIndex, y))
             ++rIndex;
     }
     else
     {
-        while (rIndex < gridData.size() && gridData[rIndex][y].VPreview == refPotential && !gridData[rIndex][y].covered)
+        while (rIndex < gridData.sizeX() && gridData.VPreview(rIndex, y) == refPotential && !gridData.covered(rIndex, y))
             ++rIndex;
     }
 
     bool done = false;
 
     // go as far down as possible with this row
-    for (; dIndex < gridData[0].size() && !done; ++dIndex)
+    for (; dIndex < gridData.sizeY() && !done; ++dIndex)
         for (int i = x; i < rIndex && !done; ++i)
         {
             double currentV;
             if (!preview)
-                currentV = gridData[i][dIndex].V ;
+                currentV = gridData.V(i, dIndex) ;
             else
-                currentV = gridData[i][dIndex].VPreview;
-            if (currentV != refPotential || gridData[i][dIndex].covered)
+                currentV = gridData.VPreview(i, dIndex);
+            if (currentV != refPotential || gridData.covered(i, dIndex))
             {
                 done = true;
                 --dIndex;   // ignore the last row (as it was invalidated in some way)
@@ -1919,7 +3231,7 @@ bool Data::findRectangle(Block& rect, int x, int y, bool preview)
 
     for (int i = x; i < rIndex; ++i)
         for (int j = y; j < dIndex; ++j)
-            gridData[i][j].covered = true;
+            gridData.covered(i, j) = true;
 
     // rectangle defined from [x,rIndex) and [y,dIndex)
     rect.xLeft = x;
@@ -1934,16 +3246,16 @@ bool Data::findRectangle(Block& rect, int x, int y, bool preview)
 double Data::getPotential(double xWorld, double yWorld, bool discretized)
 {
     // boundary is technically an infinite potential wall
-    if (xWorld<= -SIDE_LENGTH/2.0 || xWorld>= SIDE_LENGTH/2.0 || yWorld<= -SIDE_LENGTH/2.0 || yWorld>= SIDE_LENGTH/2.0)
+    if (xWorld<= -sideLengthX/2.0 || xWorld>= sideLengthX/2.0 || yWorld<= -sideLengthY/2.0 || yWorld>= sideLengthY/2.0)
         return 100.0;
 
-    int xIndex = rint((xWorld + SIDE_LENGTH/2.0)/(dR));
-    int yIndex = rint((yWorld + SIDE_LENGTH/2.0)/(dR));
+    int xIndex = rint((xWorld + sideLengthX/2.0)/(dR));
+    int yIndex = rint((yWorld + sideLengthY/2.0)/(dR));
 
     if (discretized)
     {
         // use the potential as given by gridData
-        return gridData[xIndex][yIndex].V;
+        return gridData.V(xIndex, yIndex);
     }
 
     // evaluate the equation and compare: this is obviously more costly than the above
@@ -1952,8 +3264,8 @@ double Data::getPotential(double xWorld, double yWorld, bool discretized)
         double val = parser.evaluateEquation(xWorld, yWorld);
 
         // if there is a certain error at this spot, it means the user added discrete potentials
-        if (fabs(val - gridData[xIndex][yIndex].V) >= 1.0)
-            val = gridData[xIndex][yIndex].V;
+        if (fabs(val - gridData.V(xIndex, yIndex)) >= 1.0)
+            val = gridData.V(xIndex, yIndex);
 
         return val;
     }
@@ -1987,9 +3299,9 @@ void Data::advanceSimulationClassical()
         int numRepeat = 80;
         for (int i = 0; i < numRepeat; ++i)
         {
-            verletClassical(frCoefficient*TIME_STEP/numRepeat);
-            verletClassical(frComplement*TIME_STEP/numRepeat);
-            verletClassical(frCoefficient*TIME_STEP/numRepeat);
+            verletClassical(frCoefficient*stepSize/numRepeat);
+            verletClassical(frComplement*stepSize/numRepeat);
+            verletClassical(frCoefficient*stepSize/numRepeat);
         }
     }
 
@@ -2002,81 +3314,18 @@ void Data::advanceSimulationClassical()
 
 double Data::computeNext(Mode mode, int x, int y, double dT)
 {
-    double laplacianApprox;
-    double valBefore;
-
-    // xl = value at data[x-1][y], xll = value at data[x-2][y]
-    // yt = value at data[x][y-1], etc.
-    // note that the endpoints have an infinite potential behind them
-    double xl = 0, xr = 0, yt = 0, yb = 0, centerVal = 0;
-    double xll = 0, xrr = 0, ytt = 0, ybb = 0;
-    double size = gridData.size();
-
-    if (mode == R)
-    {
-        valBefore = gridData[x][y].reCur;
-        centerVal = gridData[x][y].imCur;
-        if (x > 0)
-        {
-            xl = gridData[x-1][y].imCur;
-            if (x - 1 > 0)
-                xll = gridData[x-2][y].imCur;
-        }
-        if (x < size-1)
-        {
-            xr = gridData[x+1][y].imCur;
-            if (x + 1 < size - 1)
-                xrr = gridData[x+2][y].imCur;
-        }
-        if (y > 0)
-        {
-            yt = gridData[x][y-1].imCur;
-            if (y - 1 > 0)
-                ytt = gridData[x][y-2].imCur;
-        }
-        if (y < size-1)
-        {
-            yb = gridData[x][y+1].imCur;
-            if (y + 1 < size - 1)
-                ybb = gridData[x][y+2].imCur;
-        }
-    }
-    else if (mode == I)
-    {
-        valBefore = gridData[x][y].imCur;
-        centerVal = gridData[x][y].reCur;
-        if (x > 0)
-        {
-            xl = gridData[x-1][y].reCur;
-            if (x - 1 > 0)
-                xll = gridData[x-2][y].reCur;
-        }
-        if (x < size-1)
-        {
-            xr = gridData[x+1][y].reCur;
-            if (x + 1 < size-1)
-                xrr = gridData[x+2][y].reCur;
-        }
-        if (y > 0)
-        {
-            yt = gridData[x][y-1].reCur;
-            if (y - 1 > 0)
-                ytt = gridData[x][y-2].reCur;
-        }
-        if (y < size-1)
-        {
-            yb = gridData[x][y+1].reCur;
-            if (y + 1 < size - 1)
-                ybb = gridData[x][y+2].reCur;
-        }
-    }
+    // note that the endpoints have an infinite potential behind them (the ghost cells of gridData)
+    const double* other = ((mode == R) ? gridData.imPlane() : gridData.rePlane()) + gridData.index(x, y);
+    int s = gridData.getStride();
+    double valBefore = (mode == R) ? gridData.reCur(x, y) : gridData.imCur(x, y);
+    double centerVal = other[0];
 
-    laplacianApprox = (-(xll + xrr + ytt + ybb)/12.0 + 4.0*(xl + xr + yt + yb)/3.0 - 5.0*centerVal)/(dR*dR);
+    double laplacianApprox = Stencil<4>::laplacian(other, s)/(dR*dR);
 
     if (mode == R)
-        return valBefore + dT*(-laplacianApprox/2.0 + gridData[x][y].V*centerVal);;
+        return valBefore + dT*(-laplacianApprox/2.0 + gridData.V(x, y)*centerVal);
     if (mode == I)
-        return valBefore - dT*(-laplacianApprox/2.0 + gridData[x][y].V*centerVal);;
+        return valBefore - dT*(-laplacianApprox/2.0 + gridData.V(x, y)*centerVal);
 
     return 0.0;
 }
@@ -2104,7 +3353,7 @@ void Data::verletClassical(double timeStep)
 bool Data::findBoundingGrid(QVector<QPoint> &bounds, double xWorld, double yWorld)
 {
     QPoint closestIndices = findClosestIndicesFlat({float(xWorld), float(yWorld), 0.0},1, true);
-    QVector2D closest = { float(indexToWorld(closestIndices.x(), dR)), float(indexToWorld(closestIndices.y(), dR))};
+    QVector2D closest = { float(gridData.xCoord(closestIndices.x())), float(gridData.yCoord(closestIndices.y()))};
 
     // bounding rect depends on where Packet is relative to 'closest'
 
@@ -2158,7 +3407,7 @@ bool Data::findBoundingGrid(QVector<QPoint> &bounds, double xWorld, double yWorl
     // bottom-right as last coord
     if (bounds[0].x() < 0 || bounds[0].y() < 0)
         return false;
-    if (bounds[3].x() >= gridData.size() || bounds[3].y() >= gridData.size())
+    if (bounds[3].x() >= gridData.sizeX() || bounds[3].y() >= gridData.sizeY())
         return false;
     return true;
 }
@@ -2166,8 +3415,12 @@ bool Data::findBoundingGrid(QVector<QPoint> &bounds, double xWorld, double yWorl
 
 void Data::observe(double precision, double timeLimit)
 {
+    dropDeviceState();
+
     // fix the remaining time to 5 seconds
     elapsedTime = 0.95*timeLimit;
+    eigenProjected = false;
+    activeRegionValid = false;
     setupBucketsPosition();
     QVector2D position = observePosition();
 
@@ -2176,24 +3429,35 @@ void Data::observe(double precision, double timeLimit)
     // here is a somewhat problematic thing :
     // we will describe the newly measured wavefunction with a Gaussian peak (I do not know how legit this is),
     // as describing it as a piecewise-radial function causes discretization artefacts
-    for (int i = 0; i < samplesPerSide; ++i)
-        for (int j = 0; j < samplesPerSide; ++j)
+    double normFactor = sqrt(PI/(2.0*precision));
+    for (int i = 0; i < gridData.sizeX(); ++i)
+    {
+        double* re = gridData.rePlane() + gridData.index(i, 0);
+        double* im = gridData.imPlane() + gridData.index(i, 0);
+        double xdis = gridData.xCoord(i) - position.x();
+
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            double xdis = gridData[i][j].x - position.x();
-            double ydis = gridData[i][j].y - position.y();
-            double distance = sqrt(pow(xdis,2) + pow(ydis,2));
+            double ydis = gridData.yCoord(j) - position.y();
+            double scale = exp(-(xdis*xdis + ydis*ydis)*precision)/normFactor;
 
-            gridData[i][j].reCur *= exp(-distance*distance*precision)/sqrt(PI/(2.0*precision));
-            gridData[i][j].imCur *= exp(-distance*distance*precision)/sqrt(PI/(2.0*precision));
-            sum += dR*dR*(pow(gridData[i][j].reCur,2.0) + pow(gridData[i][j].imCur, 2.0));
+            re[j] *= scale;
+            im[j] *= scale;
+            sum += dR*dR*(re[j]*re[j] + im[j]*im[j]);
         }
+    }
 
-    for (int i = 0; i < samplesPerSide; ++i)
-        for (int j = 0; j < samplesPerSide; ++j)
+    double renormalize = sqrt(1.0/sum);
+    for (int i = 0; i < gridData.sizeX(); ++i)
+    {
+        double* re = gridData.rePlane() + gridData.index(i, 0);
+        double* im = gridData.imPlane() + gridData.index(i, 0);
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            gridData[i][j].reCur *= sqrt(1.0/sum);
-            gridData[i][j].imCur *= sqrt(1.0/sum);
+            re[j] *= renormalize;
+            im[j] *= renormalize;
         }
+    }
 }
 
 
@@ -2206,12 +3470,12 @@ void Data::setupBucketsMomentum()
 void Data::setupBucketsPosition()
 {
     double sum = 0;
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            double probDensity = pow(gridData[i][j].reCur,2) + pow(gridData[i][j].imCur,2);
+            double probDensity = pow(gridData.reCur(i, j),2) + pow(gridData.imCur(i, j),2);
             double probability = probDensity*dR*dR;
-            int index = i*gridData.size() + j;
+            int index = i*gridData.sizeY() + j;
 
             sum += probability;
             buckets[index] = sum;
@@ -2241,20 +3505,85 @@ QVector2D Data::observePosition()
         while (index < buckets.size() && buckets[index] == 0)
                 ++index;
 
-    int i = floor(double(index) / (double)gridData.size());
-    int j = index % gridData[0].size();
+    int i = floor(double(index) / (double)gridData.sizeY());
+    int j = index % gridData.sizeY();
 
-    return { float(gridData[i][j].x), float(gridData[i][j].y)};
+    return { float(gridData.xCoord(i)), float(gridData.yCoord(j))};
 }
 
 
 double Data::getProbFromIndex(int index)
 {
-    int x = floor(index/samplesPerSide);
-    int y = index%samplesPerSide;
-    return pow(gridData[x][y].reCur, 2.0) + pow(gridData[x][y].imCur, 2.0);
+    int x = floor(index/samplesY);
+    int y = index%samplesY;
+    return pow(gridData.reCur(x, y), 2.0) + pow(gridData.imCur(x, y), 2.0);
+}
+
+
+void Data::runSweepsBlocked(const vector<Sweep>& sweeps)
+{
+    // tiles overlap, so the grid cannot be written to until all of them are done: results go to a second set of planes
+    if (nextRe.size() != gridData.planeSize())
+    {
+        allocateOwned(nextRe, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());
+        allocateOwned(nextIm, gridData.sizeX() + 2*GRID_HALO, gridData.getStride());
+    }
+
+    int numTiles = (gridData.sizeX() + TILE_ROWS - 1)/TILE_ROWS;
+    for (size_t first = 0; first < sweeps.size(); first += TILE_DEPTH)
+    {
+        int depth = int(min(sweeps.size() - first, size_t(TILE_DEPTH)));
+        ThreadPool::global().parallelFor(numTiles, [&](int tile) { advanceTile(&sweeps[first], depth, tile); });
+        gridData.swapWavePlanes(nextRe, nextIm);
+    }
 }
 
 
+void Data::advanceTile(const Sweep* sweeps, int numSweeps, int tile)
+{
+    const int radius = stencilOrder/2;
+    const int nx = gridData.sizeX();
+    const int stride = gridData.getStride();
+
+    // rows produced by this tile: the tiles at the edges also take care of the ghost rows
+    int xStart = tile*TILE_ROWS;
+    int xEnd = min(nx, xStart + TILE_ROWS);
+    int outStart = (xStart == 0) ? -GRID_HALO : xStart;
+    int outEnd = (xEnd == nx) ? nx + GRID_HALO : xEnd;
+
+    // every sweep depends on radius more rows on each side: copy all of them (ghost rows included) to a local buffer,
+    // in the same layout as the grid so that the row kernels can run on it
+    int copyStart = max(-GRID_HALO, xStart - numSweeps*radius);
+    int copyEnd = min(nx + GRID_HALO, xEnd + numSweeps*radius);
+    size_t begin = size_t(copyStart + GRID_HALO)*stride;
+    size_t end = size_t(copyEnd + GRID_HALO)*stride;
+
+    static thread_local AlignedVector<double> re, im;
+    re.assign(gridData.rePlane() + begin, gridData.rePlane() + end);
+    im.assign(gridData.imPlane() + begin, gridData.imPlane() + end);
 
+    for (int s = 0; s < numSweeps; ++s)
+    {
+        // the outermost rows of the copy go stale after each sweep (their neighbours were not copied):
+        // only update the rows that the remaining sweeps still depend on, that region shrinks by radius every time
+        int margin = (numSweeps - 1 - s)*radius;
+        int xFirst = max(0, xStart - margin);
+        int xLast = min(nx, xEnd + margin);
+
+        for (int x = xFirst; x < xLast; ++x)
+            forOpenSpans(x, 0, gridData.sizeY(), [&](int yStart, int yEnd)
+            {
+                int offset = gridData.index(x, yStart);
+                computeNextSegment(sweeps[s].mode, re.data() + offset - begin, im.data() + offset - begin,
+                                   gridData.VPlane() + offset, yEnd - yStart, stride, dR, sweeps[s].timeStep, stencilOrder);
+                absorbRow(sweeps[s].mode, x, yStart, yEnd, re.data() + offset - begin - yStart,
+                          im.data() + offset - begin - yStart, sweeps[s].timeStep);
+            });
+    }
 
+    // whole rows, the ghost columns come along (still zero)
+    size_t outBegin = size_t(outStart + GRID_HALO)*stride;
+    size_t outLength = size_t(outEnd - outStart)*stride;
+    copy(re.begin() + (outBegin - begin), re.begin() + (outBegin - begin + outLength), nextRe.begin() + outBegin);
+    copy(im.begin() + (outBegin - begin), im.begin() + (outBegin - begin + outLength), nextIm.begin() + outBegin);
+}
@@ -0,0 +1,289 @@
+#include "decomposition.h"
+
+#include <string.h>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DECOMPOSITION_PROCESSES
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// polls of a shared counter before sleeping in between polls: neighbouring ranks finish their sweeps within
+// microseconds of each other, but between commands the ranks idle for whole frames
+#define DECOMPOSITION_SPIN 20000
+#define DECOMPOSITION_SLEEP_US 50
+#define DECOMPOSITION_PAGE 4096   // slabs start on pages of their own
+
+
+static size_t roundUp(size_t bytes, size_t multiple)
+{
+    return (bytes + multiple - 1)/multiple*multiple;
+}
+
+
+static void waitFor(const atomic<long>& counter, long target)
+{
+    for (int spin = 0; counter.load(memory_order_acquire) < target; ++spin)
+    {
+        if (spin < DECOMPOSITION_SPIN)
+            this_thread::yield();
+        else
+            this_thread::sleep_for(chrono::microseconds(DECOMPOSITION_SLEEP_US));
+    }
+}
+
+
+DomainDecomposition::DomainDecomposition(const Grid& grid, double dR, int order, int requestedRanks)
+    : nx(grid.sizeX()), ny(grid.sizeY()), stride(grid.getStride()), dR(dR), radius(order/2), source(&grid)
+{
+    rowOffset = grid.index(0, 0) - GRID_HALO*stride;
+    numRanks = max(1, min(min(requestedRanks, DECOMPOSITION_MAX_RANKS), nx/GRID_HALO));
+
+    // resolved here: a forked rank only has the one thread, it must not be the one to run first-call initializations
+    kernel = rowKernel(order);
+    const double* laplacian = laplacianCoefficients(order);
+    copy(laplacian, laplacian + STENCIL_MAX_RADIUS + 1, coeffs);
+
+    sharedSize = roundUp(sizeof(Control), DECOMPOSITION_PAGE);
+    for (int r = 0; r < numRanks; ++r)
+    {
+        slabStart[r] = int((long long)nx*r/numRanks);
+        slabStart[r + 1] = int((long long)nx*(r + 1)/numRanks);
+        planeSize[r] = size_t(slabStart[r + 1] - slabStart[r] + 2*GRID_HALO)*stride;
+        slabOffset[r] = sharedSize;
+        sharedSize += roundUp(3*planeSize[r]*sizeof(double), DECOMPOSITION_PAGE);
+    }
+
+#ifdef DECOMPOSITION_PROCESSES
+    void* memory = mmap(NULL, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        throw bad_alloc();
+    shared = static_cast<char*>(memory);
+#else
+    shared = AlignedAllocator<char, DECOMPOSITION_PAGE>().allocate(sharedSize);
+#endif
+
+    control = new (shared) Control();
+    control->generation.value.store(0);
+    control->completed.value.store(0);
+    for (int r = 0; r < numRanks; ++r)
+        control->published[r].value.store(0);
+
+    for (int r = 0; r < numRanks; ++r)
+    {
+#ifdef DECOMPOSITION_PROCESSES
+        int process = fork();
+        if (process == 0)
+        {
+            rankLoop(r, true);
+            _exit(0);
+        }
+        if (process > 0)
+        {
+            processes.push_back(process);
+            continue;
+        }
+#endif
+        // no processes on this platform (or no more of them): a thread runs the rank instead, with the same code
+        threads.push_back(thread(&DomainDecomposition::rankLoop, this, r, false));
+    }
+
+    // every rank copies its slab in before it takes commands
+    waitFor(control->completed.value, numRanks);
+    source = nullptr;
+}
+
+
+DomainDecomposition::~DomainDecomposition()
+{
+    send(STOP);
+
+#ifdef DECOMPOSITION_PROCESSES
+    for (size_t i = 0; i < processes.size(); ++i)
+        waitpid(processes[i], NULL, 0);
+#endif
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+#ifdef DECOMPOSITION_PROCESSES
+    munmap(shared, sharedSize);
+#else
+    AlignedAllocator<char, DECOMPOSITION_PAGE>().deallocate(shared, sharedSize);
+#endif
+}
+
+
+void DomainDecomposition::advance(const vector<Sweep>& sweeps)
+{
+    for (size_t first = 0; first < sweeps.size(); first += DECOMPOSITION_MAX_SWEEPS)
+    {
+        size_t count = min(sweeps.size() - first, size_t(DECOMPOSITION_MAX_SWEEPS));
+        copy(sweeps.begin() + first, sweeps.begin() + first + count, control->sweeps);
+        control->numSweeps = int(count);
+        send(ADVANCE);
+    }
+}
+
+
+double DomainDecomposition::getProbability(int x1, int x2, int y1, int y2)
+{
+    control->x1 = min(x1, x2);
+    control->x2 = max(x1, x2);
+    control->y1 = min(y1, y2);
+    control->y2 = max(y1, y2);
+    send(PROBABILITY);
+
+    double sum = 0;
+    for (int r = 0; r < numRanks; ++r)
+        sum += control->partial[r];
+
+    return sum*dR*dR;
+}
+
+
+void DomainDecomposition::gather(Grid& out) const
+{
+    // the ranks are idle between commands, so the slabs can be read from here
+    for (int r = 0; r < numRanks; ++r)
+        for (int x = 0; x < slabStart[r + 1] - slabStart[r]; ++x)
+        {
+            memcpy(out.rePlane() + out.index(slabStart[r] + x, 0), slabPlane(r, 0) + localIndex(x, 0), ny*sizeof(double));
+            memcpy(out.imPlane() + out.index(slabStart[r] + x, 0), slabPlane(r, 1) + localIndex(x, 0), ny*sizeof(double));
+        }
+}
+
+
+void DomainDecomposition::send(Command command)
+{
+    control->command = command;
+    ++commandsSent;
+    control->generation.value.store(commandsSent, memory_order_release);
+
+    // one more than commandsSent per rank: copying in the slab counts as well
+    waitFor(control->completed.value, long(numRanks)*(commandsSent + 1));
+}
+
+
+void DomainDecomposition::rankLoop(int rank, bool forked)
+{
+    const int first = slabStart[rank], rows = slabStart[rank + 1] - first;
+
+    // the slab is first written here, by its rank: rows [first - GRID_HALO, first + rows + GRID_HALO) of the grid,
+    // so the ghost rows start out with the neighbours' values (or the zeroes at the edges of the domain)
+    // a forked rank reads source from its own copy of the address space
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const double* from = (plane == 0) ? source->rePlane() : (plane == 1) ? source->imPlane() : source->VPlane();
+        memcpy(slabPlane(rank, plane), from + size_t(first)*stride, planeSize[rank]*sizeof(double));
+    }
+    control->completed.value.fetch_add(1, memory_order_acq_rel);
+
+#ifdef DECOMPOSITION_PROCESSES
+    const int parent = forked ? int(getppid()) : 0;
+#endif
+
+    long seen = 0, count = 0;
+    while (true)
+    {
+        for (int spin = 0; control->generation.value.load(memory_order_acquire) == seen; ++spin)
+        {
+            if (spin < DECOMPOSITION_SPIN)
+            {
+                this_thread::yield();
+                continue;
+            }
+            this_thread::sleep_for(chrono::microseconds(DECOMPOSITION_SLEEP_US));
+
+#ifdef DECOMPOSITION_PROCESSES
+            // the application is gone without stopping us (it crashed, or was killed)
+            if (forked && int(getppid()) != parent)
+                _exit(0);
+#endif
+        }
+        seen = control->generation.value.load(memory_order_acquire);
+
+        switch (control->command)
+        {
+        case ADVANCE:
+            for (int i = 0; i < control->numSweeps; ++i)
+                rankSweep(rank, control->sweeps[i], ++count);
+            break;
+        case PROBABILITY:
+        {
+            double sum = 0;
+            const double* re = slabPlane(rank, 0);
+            const double* im = slabPlane(rank, 1);
+            for (int x = max(control->x1, first); x <= min(control->x2, first + rows - 1); ++x)
+                for (int y = control->y1; y <= control->y2; ++y)
+                {
+                    size_t i = localIndex(x - first, y);
+                    sum += re[i]*re[i] + im[i]*im[i];
+                }
+            control->partial[rank] = sum;
+            break;
+        }
+        case STOP:
+            control->completed.value.fetch_add(1, memory_order_acq_rel);
+            return;
+        }
+
+        control->completed.value.fetch_add(1, memory_order_acq_rel);
+    }
+}
+
+
+void DomainDecomposition::rankSweep(int rank, const Sweep& sweep, long count)
+{
+    const int rows = slabStart[rank + 1] - slabStart[rank];
+    const bool below = rank > 0, above = rank < numRanks - 1;
+    const int plane = (sweep.mode == R) ? 0 : 1;
+    double* cur = slabPlane(rank, plane);
+    const double* other = slabPlane(rank, 1 - plane);
+    const double* V = slabPlane(rank, 2);
+
+    // same weights as computeNextSegment
+    double sign = (sweep.mode == R) ? 1.0 : -1.0;
+    RowArgs args;
+    args.length = ny;
+    args.stride = stride;
+    args.potentialWeight = sign*sweep.timeStep;
+    for (int k = 0; k <= STENCIL_MAX_RADIUS; ++k)
+        args.weights[k] = -sign*sweep.timeStep*coeffs[k]/(2.0*dR*dR);
+
+    auto sweepRows = [&](int start, int end)
+    {
+        for (int x = start; x < end; ++x)
+        {
+            args.cur = cur + localIndex(x, 0);
+            args.other = other + localIndex(x, 0);
+            args.V = V + localIndex(x, 0);
+            kernel(args);
+        }
+    };
+
+    // the rows that the neighbours read (radius of them along each shared edge) go first, then the interior
+    // while the neighbours are still busy with theirs
+    int lower = below ? radius : 0, upper = max(lower, above ? rows - radius : rows);
+    sweepRows(0, lower);
+    sweepRows(upper, rows);
+    control->published[rank].value.store(count, memory_order_release);
+    sweepRows(lower, upper);
+
+    // halo exchange, for the component that was just swept: the neighbours cannot sweep it again before they have
+    // the other one from this rank, which is only published after the copies
+    const size_t rowBytes = size_t(stride)*sizeof(double);
+    if (below)
+    {
+        int belowRows = slabStart[rank] - slabStart[rank - 1];
+        waitFor(control->published[rank - 1].value, count);
+        memcpy(cur + size_t(GRID_HALO - radius)*stride, slabPlane(rank - 1, plane) + size_t(belowRows + GRID_HALO - radius)*stride,
+               radius*rowBytes);
+    }
+    if (above)
+    {
+        waitFor(control->published[rank + 1].value, count);
+        memcpy(cur + size_t(rows + GRID_HALO)*stride, slabPlane(rank + 1, plane) + size_t(GRID_HALO)*stride, radius*rowBytes);
+    }
+}
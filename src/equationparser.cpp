@@ -183,7 +183,7 @@ float EquationParser::evaluateEquation(float x, float y)
 }
 
 
-string EquationParser::errorCheck(const QVector<QVector<Point> > &gridData)
+string EquationParser::errorCheck(const Grid& gridData)
 {
     if (standardized.size() == 0)
         return "No equation was entered";
@@ -194,10 +194,10 @@ string EquationParser::errorCheck(const QVector<QVector<Point> > &gridData)
             return "acos and asin are forbidden!";
 
     bool clipped = false;
-    for (int i = 0; i < gridData.size(); ++i)
-        for (int j = 0; j < gridData[0].size(); ++j)
+    for (int i = 0; i < gridData.sizeX(); ++i)
+        for (int j = 0; j < gridData.sizeY(); ++j)
         {
-            float val = evaluateEquation(gridData[i][j].x, gridData[i][j].y);
+            float val = evaluateEquation(gridData.xCoord(i), gridData.yCoord(j));
 
             if (isnan(val))
                 return "Undefined values encountered";
@@ -0,0 +1,272 @@
+#include "fft.h"
+#include "threadpool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+static const double TWO_PI = 6.283185307179586;
+
+
+FFTPlan::FFTPlan(int n) : n(n)
+{
+    if (n <= 1)
+        return;
+
+    // largest radix first: radix 4 passes take half as many as radix 2 ones
+    int remaining = n;
+    while (remaining%4 == 0)
+    {
+        radices.push_back(4);
+        remaining /= 4;
+    }
+    for (int p = 2; p <= FFT_MAX_RADIX && remaining > 1; ++p)
+    {
+        while (remaining%p == 0)
+        {
+            radices.push_back(p);
+            remaining /= p;
+        }
+    }
+
+    if (remaining > 1)
+    {
+        // large prime factor: cooley-tukey would be O(n*p), do a power of 2 convolution instead
+        bluestein = true;
+        radices.clear();
+
+        int m = 1;
+        while (m < 2*n - 1)
+            m *= 2;
+        convolution = make_shared<FFTPlan>(m);
+
+        chirp.resize(n);
+        for (int j = 0; j < n; ++j)
+        {
+            // j² can get large: reduce it (mod 2n) before it becomes an angle, to keep the precision
+            long long j2 = (long long)j*j%(2LL*n);
+            chirp[j] = polar(1.0, -0.5*TWO_PI*double(j2)/n);
+        }
+
+        chirpFilter.assign(m, 0.0);
+        chirpFilter[0] = conj(chirp[0]);
+        for (int j = 1; j < n; ++j)
+            chirpFilter[j] = chirpFilter[m - j] = conj(chirp[j]);
+        convolution->forward(chirpFilter.data());
+        for (int j = 0; j < m; ++j)
+            chirpFilter[j] /= double(m);
+        return;
+    }
+
+    twiddles.resize(n);
+    for (int j = 0; j < n; ++j)
+        twiddles[j] = polar(1.0, -TWO_PI*double(j)/n);
+
+    // decimation in time: the last pass combines the subsequences x[q + p*j] (p being its radix),
+    // which the earlier passes expect as contiguous blocks, and so on recursively
+    // the twiddles of every pass, in the order that the pass uses them
+    int span = 1;
+    for (size_t s = 0; s < radices.size(); ++s)
+    {
+        const int p = radices[s];
+        for (int k = 0; k < span; ++k)
+            for (int q = 1; q < p; ++q)
+                passTwiddles.push_back(twiddles[q*k*(n/(span*p))]);
+        span *= p;
+    }
+
+    permutation.resize(n);
+    for (int i = 0; i < n; ++i)
+    {
+        int position = 0, rest = i, blockSize = n;
+        for (int s = int(radices.size()) - 1; s >= 0; --s)
+        {
+            blockSize /= radices[s];
+            position += (rest%radices[s])*blockSize;
+            rest /= radices[s];
+        }
+        permutation[i] = position;
+    }
+}
+
+
+void FFTPlan::forward(cdouble* data) const
+{
+    if (n <= 1)
+        return;
+
+    if (bluestein)
+        bluesteinTransform(data);
+    else
+        radixTransform(data);
+}
+
+
+void FFTPlan::inverse(cdouble* data) const
+{
+    // conj(FFT(conj(x))) is the inverse transform (unnormalized)
+    for (int i = 0; i < n; ++i)
+        data[i] = conj(data[i]);
+    forward(data);
+    for (int i = 0; i < n; ++i)
+        data[i] = conj(data[i]);
+}
+
+
+void FFTPlan::radixTransform(cdouble* data) const
+{
+    static thread_local vector<cdouble> scratch;
+    scratch.assign(data, data + n);
+    for (int i = 0; i < n; ++i)
+        data[permutation[i]] = scratch[i];
+
+    cdouble a[FFT_MAX_RADIX], out[FFT_MAX_RADIX], roots[FFT_MAX_RADIX];
+
+    // span: length of the transforms done by the previous passes, which this pass combines p at a time
+    int span = 1;
+    const cdouble* passTwiddle = passTwiddles.data();
+    for (size_t s = 0; s < radices.size(); ++s)
+    {
+        const int p = radices[s];
+        const int length = span*p;
+
+        // p-th roots of unity, for the odd radices
+        for (int r = 0; r < p; ++r)
+            roots[r] = twiddles[r*(n/p)];
+
+        for (int start = 0; start < n; start += length)
+        {
+            for (int k = 0; k < span; ++k)
+            {
+                cdouble* x = data + start + k;
+                const cdouble* w = passTwiddle + k*(p - 1) - 1;
+                a[0] = x[0];
+                for (int q = 1; q < p; ++q)
+                    a[q] = multiply(x[q*span], w[q]);
+
+                if (p == 2)
+                {
+                    x[0] = a[0] + a[1];
+                    x[span] = a[0] - a[1];
+                }
+                else if (p == 4)
+                {
+                    // multiplying by -i is a swap and a sign change
+                    cdouble sum02 = a[0] + a[2], diff02 = a[0] - a[2];
+                    cdouble sum13 = a[1] + a[3], diff13 = a[1] - a[3];
+                    cdouble rotated(diff13.imag(), -diff13.real());
+                    x[0] = sum02 + sum13;
+                    x[span] = diff02 + rotated;
+                    x[2*span] = sum02 - sum13;
+                    x[3*span] = diff02 - rotated;
+                }
+                else
+                {
+                    // odd primes: plain DFT, they are small
+                    for (int r = 0; r < p; ++r)
+                    {
+                        out[r] = a[0];
+                        for (int q = 1, e = r; q < p; ++q, e = (e + r >= p) ? e + r - p : e + r)
+                            out[r] += multiply(a[q], roots[e]);
+                    }
+                    for (int r = 0; r < p; ++r)
+                        x[r*span] = out[r];
+                }
+            }
+        }
+
+        passTwiddle += span*(p - 1);
+        span = length;
+    }
+}
+
+
+void FFTPlan::bluesteinTransform(cdouble* data) const
+{
+    const int m = convolution->size();
+    static thread_local vector<cdouble> padded;
+    padded.assign(m, 0.0);
+
+    for (int j = 0; j < n; ++j)
+        padded[j] = multiply(data[j], chirp[j]);
+
+    // chirpFilter is already divided by m, so this is the normalized circular convolution
+    convolution->forward(padded.data());
+    for (int j = 0; j < m; ++j)
+        padded[j] = multiply(padded[j], chirpFilter[j]);
+    convolution->inverse(padded.data());
+
+    for (int k = 0; k < n; ++k)
+        data[k] = multiply(padded[k], chirp[k]);
+}
+
+
+void SinePlan::transform(cdouble* data) const
+{
+    // odd extension: 0, x[0], ..., x[n-1], 0, -x[n-1], ..., -x[0]
+    // its FFT at k + 1 is -2i*y[k]
+    const int length = extended.size();
+    static thread_local vector<cdouble> line;
+    line.assign(length, 0.0);
+    for (int j = 0; j < n; ++j)
+    {
+        line[j + 1] = data[j];
+        line[length - 1 - j] = -data[j];
+    }
+
+    extended.forward(line.data());
+
+    for (int k = 0; k < n; ++k)
+        data[k] = line[k + 1]*cdouble(0.0, 0.5);
+}
+
+
+// runs rowTransform on all rows, then columnTransform on all columns (gathered into a contiguous line first)
+static void transform2D(int numRows, int numColumns, cdouble* data, const function<void(cdouble*)>& rowTransform,
+                        const function<void(cdouble*)>& columnTransform)
+{
+    ThreadPool& pool = ThreadPool::global();
+
+    int numRowTasks = (numRows + FFT_LINES_PER_TASK - 1)/FFT_LINES_PER_TASK;
+    pool.parallelFor(numRowTasks, [&](int task)
+    {
+        int end = min(numRows, (task + 1)*FFT_LINES_PER_TASK);
+        for (int x = task*FFT_LINES_PER_TASK; x < end; ++x)
+            rowTransform(data + size_t(x)*numColumns);
+    });
+
+    int numColumnTasks = (numColumns + FFT_LINES_PER_TASK - 1)/FFT_LINES_PER_TASK;
+    pool.parallelFor(numColumnTasks, [&](int task)
+    {
+        static thread_local vector<cdouble> column;
+        column.resize(numRows);
+
+        int end = min(numColumns, (task + 1)*FFT_LINES_PER_TASK);
+        for (int y = task*FFT_LINES_PER_TASK; y < end; ++y)
+        {
+            for (int x = 0; x < numRows; ++x)
+                column[x] = data[size_t(x)*numColumns + y];
+            columnTransform(column.data());
+            for (int x = 0; x < numRows; ++x)
+                data[size_t(x)*numColumns + y] = column[x];
+        }
+    });
+}
+
+
+void fft2D(const FFTPlan& planX, const FFTPlan& planY, cdouble* data, bool inverse)
+{
+    if (inverse)
+        transform2D(planX.size(), planY.size(), data, [&](cdouble* line) { planY.inverse(line); },
+                    [&](cdouble* line) { planX.inverse(line); });
+    else
+        transform2D(planX.size(), planY.size(), data, [&](cdouble* line) { planY.forward(line); },
+                    [&](cdouble* line) { planX.forward(line); });
+}
+
+
+void sineTransform2D(const SinePlan& planX, const SinePlan& planY, cdouble* data)
+{
+    transform2D(planX.size(), planY.size(), data, [&](cdouble* line) { planY.transform(line); },
+                [&](cdouble* line) { planX.transform(line); });
+}
@@ -14,6 +14,7 @@ GLWidget::GLWidget(QWidget* parent) : QOpenGLWidget(parent), timer(parent)
     connect(&simData, SIGNAL(updateParticleBuffers()), this, SLOT(updateParticleBuffers()));
     connect(&simData, SIGNAL(updateNetBuffers()), this, SLOT(updateNetBuffers()));
     connect(&simData, SIGNAL(updateMeshBuffers()), this, SLOT(updateMeshBuffers()));
+    connect(&simData, SIGNAL(domainChanged()), this, SLOT(reallocateGridBuffers()));
 
     timer.start(16); // t.o every 16 milliseconds (to refresh screen, if needed)
     fastTimer.start(8);
@@ -229,6 +230,29 @@ void GLWidget::updateMeshBuffers()
 }
 
 
+void GLWidget::reallocateGridBuffers()
+{
+    // nothing to do before initializeGL, it allocates them with the current sizes
+    if (!gridVbo.isCreated())
+        return;
+
+    makeCurrent();
+    gridVbo.bind();
+    gridVbo.allocate(simData.getGridVertices(), simData.getGridVerticesLength() * sizeof(GLfloat));
+    gridEbo.bind();
+    gridEbo.allocate(simData.getGridElements(), simData.getGridElementsLength() * sizeof(GLuint));
+    tileVbo.bind();
+    tileVbo.allocate(simData.getTileVertices() , simData.getTileVerticesLength() * sizeof(GLfloat));
+    tileEbo.bind();
+    tileEbo.allocate(simData.getTileElements(), simData.getTileElementsLength() * sizeof(GLuint));
+    funcMeshVbo.bind();
+    funcMeshVbo.allocate(simData.getFuncMeshVertices(), simData.getFuncMeshVerticesLength() * sizeof(GLfloat));
+    funcMeshEbo.bind();
+    funcMeshEbo.allocate(simData.getFuncMeshElements(), simData.getFuncMeshElementsLength() * sizeof(GLuint));
+    doneCurrent();
+}
+
+
 void GLWidget::setSensitivity(unsigned _sensitivity)
 {
     if (hideQuantum)
@@ -465,6 +489,17 @@ void GLWidget::resetSimulation()
 }
 
 
+void GLWidget::setDomain(int samplesPerSide, double sideLength)
+{
+    chicken.lock();
+    paused = true;
+    simData.setDomain(samplesPerSide, sideLength);   // emits domainChanged: reallocateGridBuffers runs before it returns
+    chicken.unlock();
+
+    update();
+}
+
+
 void GLWidget::resizeGL(int w, int h)
 {
     camera.adjustToResize(w, h);
@@ -0,0 +1,26 @@
+#include "grid.h"
+
+
+void Grid::resize(int sizeX, int sizeY)
+{
+    const int doublesPerLine = GRID_ALIGNMENT/sizeof(double);
+
+    nx = sizeX;
+    ny = sizeY;
+    rowOffset = ((GRID_HALO + doublesPerLine - 1)/doublesPerLine)*doublesPerLine;
+    stride = ((rowOffset + ny + GRID_HALO + doublesPerLine - 1)/doublesPerLine)*doublesPerLine;
+
+    // GRID_HALO ghost rows above and below, ghost columns are part of each row:
+    // all of them must stay zero for the lifetime of the grid
+    size_t total = size_t(nx + 2*GRID_HALO)*stride;
+    allocateOwned(reData, nx + 2*GRID_HALO, stride);
+    allocateOwned(imData, nx + 2*GRID_HALO, stride);
+    allocateOwned(VData, nx + 2*GRID_HALO, stride);
+    reBeforeData.assign(total, 0.0);
+    imBeforeData.assign(total, 0.0);
+    VPreviewData.assign(total, 0.0);
+    refValData.assign(total, 0.0);
+    coveredData.assign(total, 0);
+    xCoords.assign(nx, 0.0);
+    yCoords.assign(ny, 0.0);
+}
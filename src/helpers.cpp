@@ -49,6 +49,14 @@ del^2_phi = [phi(r + deltar) - 2*phi(r) + phi(r - deltar)]/(deltar)^2
 */
 
 
+Packet clipPacket(Packet packet)
+{
+    packet.speed = min((double)MAX_SPEED, max(0.0, packet.speed));
+    packet.precision = min(4.0, max(0.2, packet.precision));
+    return packet;
+}
+
+
 cdouble computeInitial(double x, double y, const Packet& packet)
 {
     double xV0 = roundToPrecision(packet.speed*cos(packet.angle*DEG_TO_RAD), 2);
@@ -68,167 +76,308 @@ cdouble computeInitial(double x, double y, const Packet& packet)
 }
 
 
-double computeNext(Mode mode, int x, int y, double dR, double dT, const QVector<QVector<Point>>& data)
+double computeNext(Mode mode, int x, int y, double dR, double dT, const Grid& grid)
 {
-    double laplacianApprox;
-    double valBefore;
+    // R is advanced using the laplacian of I, and vice-versa:
+    // only the other component's plane is needed for the neighbours
+    // note that the endpoints have an infinite potential behind them: that is the zeroed halo of the grid,
+    // so neighbours up to GRID_HALO away can be read without any checks
+    const double* other = ((mode == R) ? grid.imPlane() : grid.rePlane()) + grid.index(x, y);
+    int s = grid.getStride();
+    double valBefore = (mode == R) ? grid.reCur(x, y) : grid.imCur(x, y);
+    double centerVal = other[0];
 
-    // xl = value at data[x-1][y], xll = value at data[x-2][y]
-    // yt = value at data[x][y-1], etc.
-    // note that the endpoints have an infinite potential behind them
-    double xl = 0, xr = 0, yt = 0, yb = 0, centerVal = 0;
-    double xll = 0, xrr = 0, ytt = 0, ybb = 0;
-    double xlll = 0, xrrr = 0, yttt = 0, ybbb = 0;
-    double size = data.size();
+    double laplacianApprox = Stencil<6>::laplacian(other, s)/(dR*dR);
 
     if (mode == R)
+        return valBefore + dT*(-laplacianApprox/2.0 + grid.V(x, y)*centerVal);
+    if (mode == I)
+        return valBefore - dT*(-laplacianApprox/2.0 + grid.V(x, y)*centerVal);
+
+    return 0.0;
+}
+
+
+void computeNextRow(Mode mode, int x, int yStart, int yEnd, double dR, double dT, Grid& grid, int order)
+{
+    int offset = grid.index(x, yStart);
+    computeNextSegment(mode, grid.rePlane() + offset, grid.imPlane() + offset, grid.VPlane() + offset,
+                       yEnd - yStart + 1, grid.getStride(), dR, dT, order);
+}
+
+
+// tables of the constexpr coefficients, for the code that picks the order at run time
+template<int Order> static const double* coefficientTable()
+{
+    static const double table[STENCIL_MAX_RADIUS + 1] = { Stencil<Order>::coefficient(0), Stencil<Order>::coefficient(1),
+        Stencil<Order>::coefficient(2), Stencil<Order>::coefficient(3), Stencil<Order>::coefficient(4) };
+    return table;
+}
+
+
+static_assert(GRID_HALO >= STENCIL_MAX_RADIUS, "the kernels read up to STENCIL_MAX_RADIUS samples into the ghost cells");
+
+
+double stiffness(double dR, int order, double maxPotential)
+{
+    // the largest eigenvalue of H is at most that of the laplacian part (gershgorin) plus the highest potential
+    const double* coeffs = laplacianCoefficients(order);
+    double kineticMax = -coeffs[0];
+    for (int k = 1; k <= order/2; ++k)
+        kineticMax += 4.0*fabs(coeffs[k]);
+    kineticMax /= 2.0*dR*dR;
+
+    return kineticMax + maxPotential;
+}
+
+
+double stableTimeStep(double dR, int order)
+{
+    // R and I are advanced in turn (leapfrog), which is stable as long as dt*|H| < 2
+    double timeStep = STABILITY_FRACTION*2.0/stiffness(dR, order);
+
+    // 2 significant digits: elapsed times stay readable (the default domain gets exactly 0.001)
+    double scale = pow(10.0, 1.0 - floor(log10(timeStep)));
+    return floor(timeStep*scale)/scale;
+}
+
+
+const double* laplacianCoefficients(int order)
+{
+    switch (order)
     {
-        valBefore = data[x][y].reCur;
-        centerVal = data[x][y].imCur;
-        if (x > 0)
-        {
-            xl = data[x-1][y].imCur;
-            if (x - 1 > 0)
-            {
-                xll = data[x-2][y].imCur;
-                if (x - 2 > 0)
-                    xlll = data[x-3][y].imCur;
-            }
-        }
-        if (x < size-1)
-        {
-            xr = data[x+1][y].imCur;
-            if (x + 1 < size - 1)
-            {
-                xrr = data[x+2][y].imCur;
-                if (x + 2 < size - 1)
-                    xrrr = data[x+3][y].imCur;
-            }
+    case 2:
+        return coefficientTable<2>();
+    case 4:
+        return coefficientTable<4>();
+    case 8:
+        return coefficientTable<8>();
+    default:
+        return coefficientTable<6>();
+    }
+}
 
-        }
-        if (y > 0)
-        {
-            yt = data[x][y-1].imCur;
-            if (y - 1 > 0)
-            {
-                ytt = data[x][y-2].imCur;
-                if (y - 2 > 0)
-                    yttt = data[x][y-3].imCur;
-            }
 
-        }
-        if (y < size-1)
+void computeNextSegment(Mode mode, double* re, double* im, const double* V, int length, int stride,
+                        double dR, double dT, int order)
+{
+    const double* coeffs = laplacianCoefficients(order);
+
+    // R only reads I and vice-versa, so updating the row in place is safe
+    double sign = (mode == R) ? 1.0 : -1.0;
+
+    RowArgs args;
+    args.cur = (mode == R) ? re : im;
+    args.other = (mode == R) ? im : re;
+    args.V = V;
+    args.length = length;
+    args.stride = stride;
+    args.potentialWeight = sign*dT;
+    for (int k = 0; k <= STENCIL_MAX_RADIUS; ++k)
+        args.weights[k] = -sign*dT*coeffs[k]/(2.0*dR*dR);
+
+    rowKernel(order)(args);
+}
+
+
+void computeNextSegment(Mode mode, float* re, float* im, const float* V, int length, int stride,
+                        double dR, double dT, int order)
+{
+    const double* coeffs = laplacianCoefficients(order);
+    double sign = (mode == R) ? 1.0 : -1.0;
+
+    RowArgsF args;
+    args.cur = (mode == R) ? re : im;
+    args.other = (mode == R) ? im : re;
+    args.V = V;
+    args.length = length;
+    args.stride = stride;
+    args.potentialWeight = float(sign*dT);
+    for (int k = 0; k <= STENCIL_MAX_RADIUS; ++k)
+        args.weights[k] = float(-sign*dT*coeffs[k]/(2.0*dR*dR));
+
+    rowKernelF(order)(args);
+}
+
+
+void solveBanded(cdouble* bands, cdouble* b, int n, int radius)
+{
+    const int width = 2*radius + 1;
+
+    // elimination: (i, i + k) lives at bands[i*width + radius + k]
+    for (int i = 0; i < n; ++i)
+    {
+        cdouble* pivotRow = bands + i*width + radius;
+        cdouble inversePivot = 1.0/pivotRow[0];
+        pivotRow[0] = inversePivot;   // kept for the back substitution
+
+        for (int j = i + 1; j <= min(n - 1, i + radius); ++j)
         {
-            yb = data[x][y+1].imCur;
-            if (y + 1 < size - 1)
-            {
-                ybb = data[x][y+2].imCur;
-                if (y + 2 < size - 1)
-                    ybbb = data[x][y+3].imCur;
-            }
+            cdouble* row = bands + j*width + radius + (i - j);   // row[k] is (j, i + k)
+            cdouble factor = multiply(row[0], inversePivot);
+            for (int k = 1; k <= radius && i + k < n; ++k)
+                row[k] -= multiply(factor, pivotRow[k]);
+            b[j] -= multiply(factor, b[i]);
         }
     }
-    else if (mode == I)
+
+    for (int i = n - 1; i >= 0; --i)
     {
-        valBefore = data[x][y].imCur;
-        centerVal = data[x][y].reCur;
-        if (x > 0)
-        {
-            xl = data[x-1][y].reCur;
-            if (x - 1 > 0)
-            {
-                xll = data[x-2][y].reCur;
-                if (x - 2 > 0)
-                    xlll = data[x-3][y].reCur;
-            }
-        }
-        if (x < size-1)
+        const cdouble* row = bands + i*width + radius;
+        cdouble sum = b[i];
+        for (int k = 1; k <= radius && i + k < n; ++k)
+            sum -= multiply(row[k], b[i + k]);
+        b[i] = multiply(sum, row[0]);
+    }
+}
+
+
+void tridiagonalEigen(vector<double>& diagonal, vector<double>& offDiagonal, vector<double>& vectors)
+{
+    const int n = int(diagonal.size());
+    vector<double>& d = diagonal;
+    vector<double> e(n, 0.0);
+    for (int i = 0; i + 1 < n && i < int(offDiagonal.size()); ++i)
+        e[i] = offDiagonal[i];
+
+    vectors.assign(size_t(n)*n, 0.0);
+    for (int i = 0; i < n; ++i)
+        vectors[size_t(i)*n + i] = 1.0;
+
+    for (int l = 0; l < n; ++l)
+    {
+        for (int iteration = 0; iteration < 60; ++iteration)
         {
-            xr = data[x+1][y].reCur;
-            if (x + 1 < size-1)
+            // look for a negligible off-diagonal element to split the matrix at
+            int m = l;
+            for (; m < n - 1; ++m)
             {
-                xrr = data[x+2][y].reCur;
-                if (x + 2 < size - 1)
-                    xrrr = data[x+3][y].reCur;
+                double scale = fabs(d[m]) + fabs(d[m + 1]);
+                if (fabs(e[m]) <= numeric_limits<double>::epsilon()*scale)
+                    break;
             }
-        }
-        if (y > 0)
-        {
-            yt = data[x][y-1].reCur;
-            if (y - 1 > 0)
+            if (m == l)
+                break;
+
+            // wilkinson shift, then chase the bulge from m up to l with givens rotations
+            double g = (d[l + 1] - d[l])/(2.0*e[l]);
+            double r = hypot(g, 1.0);
+            g = d[m] - d[l] + e[l]/(g + copysign(r, g));
+            double s = 1.0, c = 1.0, p = 0.0;
+            int i = m - 1;
+            for (; i >= l; --i)
             {
-                ytt = data[x][y-2].reCur;
-                if (y - 2 > 0)
-                    yttt = data[x][y-3].reCur;
-            }
-        }
-        if (y < size-1)
-        {
-            yb = data[x][y+1].reCur;
-            if (y + 1 < size - 1)
-            {
-                ybb = data[x][y+2].reCur;
-                if (y + 2 < size - 1)
-                    ybbb = data[x][y+3].reCur;
+                double f = s*e[i];
+                double b = c*e[i];
+                r = hypot(f, g);
+                e[i + 1] = r;
+                if (r == 0.0)
+                {
+                    // underflow: skip the rest of the rotations
+                    d[i + 1] -= p;
+                    e[m] = 0.0;
+                    break;
+                }
+                s = f/r;
+                c = g/r;
+                g = d[i + 1] - p;
+                r = (d[i] - g)*s + 2.0*c*b;
+                p = s*r;
+                d[i + 1] = g + p;
+                g = c*r - b;
+
+                for (int k = 0; k < n; ++k)
+                {
+                    double* row = vectors.data() + size_t(k)*n;
+                    f = row[i + 1];
+                    row[i + 1] = s*row[i] + c*f;
+                    row[i] = c*row[i] - s*f;
+                }
             }
+            if (r == 0.0 && i >= l)
+                continue;
+            d[l] -= p;
+            e[l] = g;
+            e[m] = 0.0;
         }
     }
 
-    laplacianApprox = ((xlll + xrrr + yttt + ybbb)/90.0 -3.0*(xll + xrr + ytt + ybb)/20.0 + 3.0*(xl + xr + yt + yb)/2.0 - 49.0*centerVal/9.0)/(dR*dR);
+    // ascending order (selection sort, swapping columns along)
+    for (int i = 0; i < n - 1; ++i)
+    {
+        int smallest = int(min_element(d.begin() + i, d.end()) - d.begin());
+        if (smallest == i)
+            continue;
+        swap(d[i], d[smallest]);
+        for (int k = 0; k < n; ++k)
+            swap(vectors[size_t(k)*n + i], vectors[size_t(k)*n + smallest]);
+    }
+}
 
-    if (mode == R)
-        return valBefore + dT*(-laplacianApprox/2.0 + data[x][y].V*centerVal);
-    if (mode == I)
-        return valBefore - dT*(-laplacianApprox/2.0 + data[x][y].V*centerVal);
 
-    return 0.0;
-}
+vector<double> besselSeries(double x, double tolerance)
+{
+    if (x < EPSILON)
+        return vector<double>(1, 1.0);
 
+    // past k ~ x, J_k(x) falls off like exp(-(k - x)^1.5/sqrt(x)): starting this far out, the start value is lost
+    int start = int(x + 10.0*cbrt(x) + 20.0);
+    vector<double> J(start + 2, 0.0);
+    J[start] = 1E-30;
 
+    for (int k = start; k >= 1; --k)
+    {
+        J[k - 1] = 2.0*k/x*J[k] - J[k + 1];
 
-template<typename T> void fftImage(const QVector<QVector<T>>& in, QVector<QVector<T>>& out)
-{
+        // the recurrence grows very fast going down: rescale everything computed so far before it overflows
+        if (fabs(J[k - 1]) > 1E250)
+            for (int i = k - 1; i <= start; ++i)
+                J[i] *= 1E-250;
+    }
+
+    double sum = J[0];
+    for (int k = 2; k <= start; k += 2)
+        sum += 2.0*J[k];
+    for (int k = 0; k <= start; ++k)
+        J[k] /= sum;
 
+    int last = start;
+    while (last > 0 && last > x && fabs(J[last]) < tolerance)
+        --last;
+    J.resize(last + 1);
+    return J;
 }
 
 
-// recursively performs fft, but is restricted to go along
-// 1) x direction, 2) either u or v
-// in other words, this helper performs a 1-D fft along specified axes
-// returns the fft of the elements of in, specified by 'start' and 'stepSize'
-template<typename T> QVector<T> fftHelper(const QVector<T>& in, int start, int stepSize, char mode)
+void appendSweep(vector<Sweep>& sweeps, Mode mode, double timeStep)
 {
-    cdouble i = sqrt(cdouble(-1));
+    if (!sweeps.empty() && sweeps.back().mode == mode)
+        sweeps.back().timeStep += timeStep;
+    else
+        sweeps.push_back({mode, timeStep});
+}
 
-    // base case
-    if (start + stepSize >= in.size())  // in other words, there is only 1 element
-        return {in[start]};
 
-    // get the even and odd sequences that help constitute all elements of this one
-    // assuming that we are using a power of 2 : that would help a lot
-    QVector<T> evenCoeffs = fftHelper(in, start, stepSize*2, mode);
-    QVector<T> oddCoeffs = fftHelper(in, start + stepSize, stepSize*2, mode);
-    QVector<T> ret(evenCoeffs.size() + oddCoeffs.size());
-    double period = in.size();
+template<typename T> void fftImage(const QVector<QVector<T>>& in, QVector<QVector<T>>& out)
+{
+    int sizeX = in.size();
+    int sizeY = (sizeX > 0) ? in[0].size() : 0;
+    vector<cdouble> image(size_t(sizeX)*sizeY);
 
-    // TESTING
-    if (evenCoeffs.size() != oddCoeffs.size() || ret.size()*stepSize != in.size())
-        cout << "something went wrong ..." << endl;
+    for (int x = 0; x < sizeX; ++x)
+        for (int y = 0; y < sizeY; ++y)
+            image[size_t(x)*sizeY + y] = in[x][y];
 
-    // compute each element based on evenCoeffs and oddCoeffs
-    for (int k = 0; k < evenCoeffs.size(); ++k)
-    {
-        T factor = exp(-i*cdouble(2.0*PI*double(k*stepSize)/period));
-        ret[k] = evenCoeffs[k] + oddCoeffs[k]*factor;
-        ret[k + evenCoeffs.size()] = evenCoeffs[k] - oddCoeffs[k]*factor;
-    }
+    fft2D(FFTPlan(sizeX), FFTPlan(sizeY), image.data());
 
-    return ret;
+    out = QVector<QVector<T>>(sizeX, QVector<T>(sizeY));
+    for (int x = 0; x < sizeX; ++x)
+        for (int y = 0; y < sizeY; ++y)
+            out[x][y] = image[size_t(x)*sizeY + y];
 }
 
 // instantiated templates, ready for use : cdouble is just complex<double>
-template QVector<cdouble> fftHelper<cdouble>(const QVector<cdouble>& in, int start, int stepSize, char mode);
-//template QVector<cdouble> fftHelper<cdouble>(const QVector<cdouble>& in, int start, int stepSize, char mode);
+template void fftImage<cdouble>(const QVector<QVector<cdouble>>& in, QVector<QVector<cdouble>>& out);
 
 
 double interpolateBicubic(double ll, double l, double r, double rr, double d)
@@ -251,13 +400,25 @@ double interpolateBicubic2D(const QVector<QVector<double> > &values, double xDis
 //-------------------------------------------------------------------------------------------
 
 
+static double sideLength = DEFAULT_SIDE_LENGTH;
+
+double worldSideLength()
+{
+    return sideLength;
+}
+
+void setWorldSideLength(double length)
+{
+    sideLength = length;
+}
+
 // conversion from screen coordinates to world coordinates:
-// world coordinates range from -SIDE_LENGTH/2 to SIDE_LENGTH/2
+// world coordinates range from -worldSideLength()/2 to worldSideLength()/2
 // screen coordinates range from -1.0 to 1.0
 // these are not by default normalized
 double GLToWorld(double screenCoord)
 {
-    return (screenCoord)*SIDE_LENGTH/2.0;
+    return (screenCoord)*sideLength/2.0;
 }
 
 QVector3D GLToWorld(const QVector3D &glCoord)
@@ -268,7 +429,7 @@ QVector3D GLToWorld(const QVector3D &glCoord)
 // as of now this function is not used
 double worldToGL(double worldCoord)
 {
-    return (worldCoord)/(SIDE_LENGTH/2.0);
+    return (worldCoord)/(sideLength/2.0);
 }
 
 QVector3D worldToGL(const QVector3D &worldCoord)
@@ -276,11 +437,11 @@ QVector3D worldToGL(const QVector3D &worldCoord)
     return { float(worldToGL(worldCoord[0])), float(worldToGL(worldCoord[1])), float(worldToGL(worldCoord[2]))};
 }
 
-// conversion from a x, y index to world coordinates
-double indexToWorld(int index, double dR)
+// conversion from a x (or y) index to world coordinates, along an axis of length axisLength centered on the origin
+double indexToWorld(int index, double dR, double axisLength)
 {
     double delta = index*dR;
-    return delta - SIDE_LENGTH/2.0;
+    return delta - axisLength/2.0;
 }
 
 // used for converting a z-coordinate to an appropriate potential value
@@ -326,8 +487,8 @@ QVector2D scrnToGL(int xScrn, int yScrn, int w, int h)
 
 double stretchToSpeed(double stretch)
 {
-    // can stretch as far as 0.25*SIDE_LENGTH
-    return stretch*MAX_SPEED/(0.25*SIDE_LENGTH);
+    // can stretch as far as 0.25*worldSideLength()
+    return stretch*MAX_SPEED/(0.25*sideLength);
 }
 
 
@@ -611,12 +772,12 @@ double clipPotential(double potential)
 }
 
 // one of those either use while loop or recursion problems
-int numVerticesAfterScaling(int numOriginal, int scaling)
+int verticesAfterScaling(int numOriginal, int scaling)
 {
     if (scaling <= 1)
         return numOriginal;
 
-    return pow(2.0*sqrt(numVerticesAfterScaling(numOriginal, scaling - 1)) - 1.0, 2.0);
+    return 2*verticesAfterScaling(numOriginal, scaling - 1) - 1;
 }
 
 
@@ -0,0 +1,341 @@
+#include "kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// hand-vectorized paths are only compiled for x86 with gcc/clang (mingw included), which let us
+// enable instruction sets per function: the rest of the program is still built for the baseline CPU
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+
+//-------------------------------------------------------------------------------------------
+// SCALAR
+//-------------------------------------------------------------------------------------------
+
+template<int Order, typename T> static void rowScalar(const RowArgsT<T>& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride;
+
+    for (int y = 0; y < a.length; ++y)
+    {
+        const T* o = a.other + y;
+        T update = (a.weights[0] + a.potentialWeight*a.V[y])*o[0];
+
+        for (int k = 1; k <= Radius; ++k)
+            update += a.weights[k]*((o[-k] + o[k]) + (o[-k*s] + o[k*s]));
+
+        a.cur[y] += update;
+    }
+}
+
+
+template<int Order> static void batchScalar(const BatchArgs& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride, l = a.lanes;
+
+    for (int y = 0; y < a.length; ++y)
+    {
+        const double centerWeight = a.weights[0] + a.potentialWeight*a.V[y];
+        for (int b = 0; b < l; ++b)
+        {
+            const double* o = a.other + size_t(y)*l + b;
+            double update = centerWeight*o[0];
+
+            for (int k = 1; k <= Radius; ++k)
+                update += a.weights[k]*((o[-k*l] + o[k*l]) + (o[-k*s] + o[k*s]));
+
+            a.cur[size_t(y)*l + b] += update;
+        }
+    }
+}
+
+
+#ifdef KERNELS_X86
+
+//-------------------------------------------------------------------------------------------
+// AVX2: 4 samples at a time
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX2 void rowAvx2(const RowArgs& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride;
+    const __m256d potentialWeight = _mm256_set1_pd(a.potentialWeight);
+    __m256d weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm256_set1_pd(a.weights[k]);
+
+    int y = 0;
+    for (; y + 4 <= a.length; y += 4)
+    {
+        const double* o = a.other + y;
+        __m256d center = _mm256_loadu_pd(o);
+        __m256d centerWeight = _mm256_fmadd_pd(potentialWeight, _mm256_loadu_pd(a.V + y), weights[0]);
+        __m256d update = _mm256_mul_pd(centerWeight, center);
+
+        for (int k = 1; k <= Radius; ++k)
+        {
+            __m256d horizontal = _mm256_add_pd(_mm256_loadu_pd(o - k), _mm256_loadu_pd(o + k));
+            __m256d vertical = _mm256_add_pd(_mm256_loadu_pd(o - k*s), _mm256_loadu_pd(o + k*s));
+            update = _mm256_fmadd_pd(weights[k], _mm256_add_pd(horizontal, vertical), update);
+        }
+
+        _mm256_storeu_pd(a.cur + y, _mm256_add_pd(_mm256_loadu_pd(a.cur + y), update));
+    }
+
+    // leftovers (at most 3)
+    if (y < a.length)
+    {
+        RowArgs tail = a;
+        tail.cur += y;
+        tail.other += y;
+        tail.V += y;
+        tail.length -= y;
+        rowScalar<Order, double>(tail);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------
+// AVX-512: 8 samples at a time, the end of the segment is handled with a masked iteration
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX512 void rowAvx512(const RowArgs& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride;
+    const __m512d potentialWeight = _mm512_set1_pd(a.potentialWeight);
+    __m512d weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm512_set1_pd(a.weights[k]);
+
+    for (int y = 0; y < a.length; y += 8)
+    {
+        const double* o = a.other + y;
+        int remaining = a.length - y;
+        __mmask8 m = remaining >= 8 ? __mmask8(0xFF) : __mmask8((1u << remaining) - 1);
+
+        __m512d center = _mm512_maskz_loadu_pd(m, o);
+        __m512d centerWeight = _mm512_fmadd_pd(potentialWeight, _mm512_maskz_loadu_pd(m, a.V + y), weights[0]);
+        __m512d update = _mm512_mul_pd(centerWeight, center);
+
+        for (int k = 1; k <= Radius; ++k)
+        {
+            __m512d horizontal = _mm512_add_pd(_mm512_maskz_loadu_pd(m, o - k), _mm512_maskz_loadu_pd(m, o + k));
+            __m512d vertical = _mm512_add_pd(_mm512_maskz_loadu_pd(m, o - k*s), _mm512_maskz_loadu_pd(m, o + k*s));
+            update = _mm512_fmadd_pd(weights[k], _mm512_add_pd(horizontal, vertical), update);
+        }
+
+        __m512d cur = _mm512_maskz_loadu_pd(m, a.cur + y);
+        _mm512_mask_storeu_pd(a.cur + y, m, _mm512_add_pd(cur, update));
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------
+// AVX2, batched: 4 packets of a sample at a time, the lanes are a multiple of 4
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX2 void batchAvx2(const BatchArgs& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride, l = a.lanes;
+    const __m256d potentialWeight = _mm256_set1_pd(a.potentialWeight);
+    __m256d weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm256_set1_pd(a.weights[k]);
+
+    for (int y = 0; y < a.length; ++y)
+    {
+        __m256d centerWeight = _mm256_fmadd_pd(potentialWeight, _mm256_set1_pd(a.V[y]), weights[0]);
+        for (int b = 0; b < l; b += 4)
+        {
+            const double* o = a.other + size_t(y)*l + b;
+            double* cur = a.cur + size_t(y)*l + b;
+            __m256d update = _mm256_mul_pd(centerWeight, _mm256_load_pd(o));
+
+            for (int k = 1; k <= Radius; ++k)
+            {
+                __m256d horizontal = _mm256_add_pd(_mm256_load_pd(o - k*l), _mm256_load_pd(o + k*l));
+                __m256d vertical = _mm256_add_pd(_mm256_load_pd(o - k*s), _mm256_load_pd(o + k*s));
+                update = _mm256_fmadd_pd(weights[k], _mm256_add_pd(horizontal, vertical), update);
+            }
+
+            _mm256_store_pd(cur, _mm256_add_pd(_mm256_load_pd(cur), update));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------
+// AVX-512, batched: 8 packets of a sample at a time, the lanes are a multiple of 8
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX512 void batchAvx512(const BatchArgs& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride, l = a.lanes;
+    const __m512d potentialWeight = _mm512_set1_pd(a.potentialWeight);
+    __m512d weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm512_set1_pd(a.weights[k]);
+
+    for (int y = 0; y < a.length; ++y)
+    {
+        __m512d centerWeight = _mm512_fmadd_pd(potentialWeight, _mm512_set1_pd(a.V[y]), weights[0]);
+        for (int b = 0; b < l; b += 8)
+        {
+            const double* o = a.other + size_t(y)*l + b;
+            double* cur = a.cur + size_t(y)*l + b;
+            __m512d update = _mm512_mul_pd(centerWeight, _mm512_load_pd(o));
+
+            for (int k = 1; k <= Radius; ++k)
+            {
+                __m512d horizontal = _mm512_add_pd(_mm512_load_pd(o - k*l), _mm512_load_pd(o + k*l));
+                __m512d vertical = _mm512_add_pd(_mm512_load_pd(o - k*s), _mm512_load_pd(o + k*s));
+                update = _mm512_fmadd_pd(weights[k], _mm512_add_pd(horizontal, vertical), update);
+            }
+
+            _mm512_store_pd(cur, _mm512_add_pd(_mm512_load_pd(cur), update));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------
+// AVX2, single precision: 8 samples at a time
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX2 void rowAvx2F(const RowArgsF& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride;
+    const __m256 potentialWeight = _mm256_set1_ps(a.potentialWeight);
+    __m256 weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm256_set1_ps(a.weights[k]);
+
+    int y = 0;
+    for (; y + 8 <= a.length; y += 8)
+    {
+        const float* o = a.other + y;
+        __m256 center = _mm256_loadu_ps(o);
+        __m256 centerWeight = _mm256_fmadd_ps(potentialWeight, _mm256_loadu_ps(a.V + y), weights[0]);
+        __m256 update = _mm256_mul_ps(centerWeight, center);
+
+        for (int k = 1; k <= Radius; ++k)
+        {
+            __m256 horizontal = _mm256_add_ps(_mm256_loadu_ps(o - k), _mm256_loadu_ps(o + k));
+            __m256 vertical = _mm256_add_ps(_mm256_loadu_ps(o - k*s), _mm256_loadu_ps(o + k*s));
+            update = _mm256_fmadd_ps(weights[k], _mm256_add_ps(horizontal, vertical), update);
+        }
+
+        _mm256_storeu_ps(a.cur + y, _mm256_add_ps(_mm256_loadu_ps(a.cur + y), update));
+    }
+
+    // leftovers (at most 7)
+    if (y < a.length)
+    {
+        RowArgsF tail = a;
+        tail.cur += y;
+        tail.other += y;
+        tail.V += y;
+        tail.length -= y;
+        rowScalar<Order, float>(tail);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------
+// AVX-512, single precision: 16 samples at a time, masked at the end of the segment
+//-------------------------------------------------------------------------------------------
+
+template<int Order> static TARGET_AVX512 void rowAvx512F(const RowArgsF& a)
+{
+    const int Radius = Stencil<Order>::radius;
+    const int s = a.stride;
+    const __m512 potentialWeight = _mm512_set1_ps(a.potentialWeight);
+    __m512 weights[Radius + 1];
+    for (int k = 0; k <= Radius; ++k)
+        weights[k] = _mm512_set1_ps(a.weights[k]);
+
+    for (int y = 0; y < a.length; y += 16)
+    {
+        const float* o = a.other + y;
+        int remaining = a.length - y;
+        __mmask16 m = remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1);
+
+        __m512 center = _mm512_maskz_loadu_ps(m, o);
+        __m512 centerWeight = _mm512_fmadd_ps(potentialWeight, _mm512_maskz_loadu_ps(m, a.V + y), weights[0]);
+        __m512 update = _mm512_mul_ps(centerWeight, center);
+
+        for (int k = 1; k <= Radius; ++k)
+        {
+            __m512 horizontal = _mm512_add_ps(_mm512_maskz_loadu_ps(m, o - k), _mm512_maskz_loadu_ps(m, o + k));
+            __m512 vertical = _mm512_add_ps(_mm512_maskz_loadu_ps(m, o - k*s), _mm512_maskz_loadu_ps(m, o + k*s));
+            update = _mm512_fmadd_ps(weights[k], _mm512_add_ps(horizontal, vertical), update);
+        }
+
+        __m512 cur = _mm512_maskz_loadu_ps(m, a.cur + y);
+        _mm512_mask_storeu_ps(a.cur + y, m, _mm512_add_ps(cur, update));
+    }
+}
+
+#endif // KERNELS_X86
+
+
+//-------------------------------------------------------------------------------------------
+// DISPATCH
+//-------------------------------------------------------------------------------------------
+
+static RowKernels selectKernels()
+{
+    // one entry per order of stencil.h
+    RowKernels scalar = { { NULL, &rowScalar<2, double>, &rowScalar<4, double>, &rowScalar<6, double>, &rowScalar<8, double> },
+                          { NULL, &rowScalar<2, float>, &rowScalar<4, float>, &rowScalar<6, float>, &rowScalar<8, float> },
+                          { NULL, &batchScalar<2>, &batchScalar<4>, &batchScalar<6>, &batchScalar<8> },
+                          "scalar" };
+
+    // allow capping the instruction set, i.e to compare results between paths
+    const char* cap = getenv("QUTOSS_KERNELS");
+    if (cap != NULL && strcmp(cap, "scalar") == 0)
+        return scalar;
+
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    bool allowAvx512 = cap == NULL || strcmp(cap, "avx512") == 0;
+
+    if (allowAvx512 && __builtin_cpu_supports("avx512f"))
+    {
+        RowKernels avx512 = { { NULL, &rowAvx512<2>, &rowAvx512<4>, &rowAvx512<6>, &rowAvx512<8> },
+                              { NULL, &rowAvx512F<2>, &rowAvx512F<4>, &rowAvx512F<6>, &rowAvx512F<8> },
+                              { NULL, &batchAvx512<2>, &batchAvx512<4>, &batchAvx512<6>, &batchAvx512<8> },
+                              "avx512" };
+        return avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        RowKernels avx2 = { { NULL, &rowAvx2<2>, &rowAvx2<4>, &rowAvx2<6>, &rowAvx2<8> },
+                            { NULL, &rowAvx2F<2>, &rowAvx2F<4>, &rowAvx2F<6>, &rowAvx2F<8> },
+                            { NULL, &batchAvx2<2>, &batchAvx2<4>, &batchAvx2<6>, &batchAvx2<8> },
+                            "avx2" };
+        return avx2;
+    }
+#endif
+
+    return scalar;
+}
+
+
+const RowKernels& rowKernels()
+{
+    static const RowKernels kernels = selectKernels();
+    return kernels;
+}
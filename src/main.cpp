@@ -4,7 +4,13 @@
 #include <QSurfaceFormat>
 #include <QtGui>
 #include <QLabel>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <fstream>
 #include "window.h"
+#include "study.h"
+#include "clsolver.h"
+#include "decomposition.h"
 
 
 /*
@@ -25,8 +31,186 @@ TDSE eigenstates solver feature:
 using namespace std;
 
 
+// qutoss --study [options]: runs a parameter study (see study.h) without opening a window, and writes its table
+// every packet field and the equation take several values, all of their combinations are run
+static int runStudyCommand(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs one simulation per combination of the values given, and writes the "
+                                     "netted probability, norm and transmission of each of them as CSV.\n"
+                                     "Lists of values are either a,b,c or start:end:step.");
+    parser.addHelpOption();
+
+    QCommandLineOption study("study", "Run a parameter study instead of the GUI.");
+    QCommandLineOption equation("equation", "Potential, as in the equation box (repeat for several, default 0).", "eq");
+    QCommandLineOption xCen("xcen", "Packet centers along x (default 0).", "list", "0");
+    QCommandLineOption yCen("ycen", "Packet centers along y (default 0).", "list", "0");
+    QCommandLineOption angle("angle", "Packet angles, in degrees (default 0).", "list", "0");
+    QCommandLineOption speed("speed", "Packet speeds (default 0).", "list", "0");
+    QCommandLineOption precision("precision", "Packet precisions (default 1).", "list", "1");
+    QCommandLineOption samples("samples", "Samples per side of the domain.", "n", QString::number(DEFAULT_SAMPLES_PER_SIDE));
+    QCommandLineOption length("length", "Side length of the domain.", "length", QString::number(DEFAULT_SIDE_LENGTH));
+    QCommandLineOption frames("frames", "Frames per run.", "n", QString::number(STUDY_FRAMES));
+    QCommandLineOption steps("steps", "Time steps per frame (the simulation speed).", "n", "1");
+    QCommandLineOption integrator("integrator", "verlet, pefrl, split, adi, eigen or chebyshev.", "name", "verlet");
+    QCommandLineOption order("order", "Stencil order of the laplacian: 2, 4, 6 or 8.", "n", "6");
+    QCommandLineOption absorbing("absorbing", "Width of an absorbing layer along the edges (default none).", "width", "0");
+    QCommandLineOption net("net", "Rectangle of the netted probability (default the whole domain).", "x1,x2,y1,y2");
+    QCommandLineOption transmission("transmission", "Transmission is the probability past this x (default 0).", "x", "0");
+    QCommandLineOption separate("separate", "One run per point, rather than batches of packets.");
+    QCommandLineOption backend("backend", "cpu, or opencl to run the sweeps on an OpenCL device (one run per point).",
+                               "name", "cpu");
+    QCommandLineOption ranks("ranks", "Split every run between this many ranks (processes), for large grids.", "n", "1");
+    QCommandLineOption output("output", "File to write the table to (default stdout).", "file");
+    parser.addOptions({study, equation, xCen, yCen, angle, speed, precision, samples, length, frames, steps,
+                       integrator, order, absorbing, net, transmission, separate, backend, ranks, output});
+    parser.process(app);
+
+    vector<double> values[5];
+    const QCommandLineOption* lists[5] = {&xCen, &yCen, &angle, &speed, &precision};
+    for (int i = 0; i < 5; ++i)
+    {
+        string message = parseValueList(parser.value(*lists[i]).toStdString(), values[i]);
+        if (!message.empty())
+        {
+            cerr << "--" << lists[i]->names().first().toStdString() << ": " << message << endl;
+            return 1;
+        }
+    }
+
+    vector<string> equations;
+    for (const QString& eq : parser.values(equation))
+        equations.push_back(eq.toStdString());
+    if (equations.empty())
+        equations.push_back("0");
+
+    // the sizes have to be positive (a zero length is a zero dR, and a NaN time step), the rest just numbers
+    auto number = [&](const QCommandLineOption& option, bool positive, bool integer, double& value) -> bool
+    {
+        bool ok;
+        value = parser.value(option).toDouble(&ok);
+        if (ok && std::isfinite(value) && (!positive || value > 0) && (!integer || value == floor(value)))
+            return true;
+        cerr << "--" << option.names().first().toStdString() << ": expected a " << (positive ? "positive " : "")
+             << (integer ? "integer" : "number") << ", not " << parser.value(option).toStdString() << endl;
+        return false;
+    };
+
+    double sampleCount, sideLength, frameCount, stepCount, stencilOrder, absorbingWidth, transmissionX, rankCount;
+    if (!number(samples, true, true, sampleCount) || !number(length, true, false, sideLength) ||
+        !number(frames, true, true, frameCount) || !number(steps, true, true, stepCount) ||
+        !number(order, true, true, stencilOrder) || !number(absorbing, false, false, absorbingWidth) ||
+        !number(transmission, false, false, transmissionX) || !number(ranks, true, true, rankCount))
+        return 1;
+    if (rankCount > DECOMPOSITION_MAX_RANKS)
+    {
+        cerr << "--ranks: at most " << DECOMPOSITION_MAX_RANKS << endl;
+        return 1;
+    }
+    if (stencilOrder != 2 && stencilOrder != 4 && stencilOrder != 6 && stencilOrder != 8)
+    {
+        cerr << "--order: expected 2, 4, 6 or 8, not " << parser.value(order).toStdString() << endl;
+        return 1;
+    }
+    if (absorbingWidth < 0)
+    {
+        cerr << "--absorbing: the width cannot be negative" << endl;
+        return 1;
+    }
+
+    StudySettings settings;
+    settings.samplesX = settings.samplesY = int(sampleCount);
+    settings.sideLengthX = sideLength;
+    settings.numFrames = int(frameCount);
+    settings.simSpeed = unsigned(stepCount);
+    settings.stencilOrder = int(stencilOrder);
+    settings.absorbingWidth = absorbingWidth;
+    settings.transmissionX = transmissionX;
+    settings.batched = !parser.isSet(separate);
+    settings.ranks = int(rankCount);
+
+    const QStringList names = {"verlet", "pefrl", "split", "adi", "eigen", "chebyshev"};
+    int method = names.indexOf(parser.value(integrator).toLower());
+    if (method < 0)
+    {
+        cerr << "--integrator: unknown integrator " << parser.value(integrator).toStdString() << endl;
+        return 1;
+    }
+    settings.integrator = Integrator(method);
+
+    QString backendName = parser.value(backend).toLower();
+    if (backendName != "cpu" && backendName != "opencl")
+    {
+        cerr << "--backend: unknown backend " << backendName.toStdString() << endl;
+        return 1;
+    }
+    settings.backend = (backendName == "opencl") ? OPENCL_BACKEND : CPU_BACKEND;
+    if (settings.backend == OPENCL_BACKEND)
+    {
+        // every Data of the study would fall back to the CPU one by one otherwise
+        OpenCLSolver probe;
+        if (!probe.isReady())
+        {
+            cerr << "--backend: " << probe.getStatus() << endl;
+            return 1;
+        }
+        cerr << "OpenCL device: " << probe.getDeviceName() << endl;
+    }
+
+    // DomainDecomposition only does the plain sweeps (see study.h)
+    if (settings.ranks > 1 && (settings.backend != CPU_BACKEND || settings.absorbingWidth > 0 ||
+                               (settings.integrator != VERLET && settings.integrator != PEFRL)))
+    {
+        cerr << "--ranks: only with verlet or pefrl, on the cpu and without an absorbing layer" << endl;
+        return 1;
+    }
+
+    if (parser.isSet(net))
+    {
+        vector<double> corners;
+        if (!parseValueList(parser.value(net).toStdString(), corners).empty() || corners.size() != 4)
+        {
+            cerr << "--net: expected x1,x2,y1,y2" << endl;
+            return 1;
+        }
+        settings.netXStart = min(corners[0], corners[1]);
+        settings.netXEnd = max(corners[0], corners[1]);
+        settings.netYStart = min(corners[2], corners[3]);
+        settings.netYEnd = max(corners[2], corners[3]);
+    }
+
+    vector<StudyPoint> points = studyGrid(equations, values[0], values[1], values[2], values[3], values[4]);
+    vector<StudyResult> results = runStudy(points, settings, [&](int done)
+    {
+        cerr << "\r" << done << "/" << points.size() << " runs" << flush;
+    });
+    cerr << endl;
+
+    if (parser.isSet(output))
+    {
+        ofstream file(parser.value(output).toStdString());
+        if (!file)
+        {
+            cerr << "--output: cannot open " << parser.value(output).toStdString() << endl;
+            return 1;
+        }
+        writeStudyTable(file, results);
+    }
+    else
+        writeStudyTable(cout, results);
+
+    return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
+    // headless, so it must be known before the QApplication is created (which needs a display)
+    for (int i = 1; i < argc; ++i)
+        if (QString(argv[i]) == "--study")
+            return runStudyCommand(argc, argv);
+
     QApplication app(argc, argv);
 
 #if defined(Q_OS_MAC)
@@ -48,12 +232,34 @@ int main(int argc, char *argv[])
 
 #endif
 
+    // the domain, as for --study: smaller grids preview faster, larger ones resolve more
+    QCommandLineParser parser;
+    QCommandLineOption samples("samples", "Samples per side of the domain.", "n", QString::number(DEFAULT_SAMPLES_PER_SIDE));
+    QCommandLineOption length("length", "Side length of the domain.", "length", QString::number(DEFAULT_SIDE_LENGTH));
+    parser.addOptions({samples, length});
+    parser.parse(app.arguments());   // anything else is left to Qt (and to the Finder's -psn_ on macOS)
+
+    bool samplesOk, lengthOk;
+    int samplesPerSide = parser.value(samples).toInt(&samplesOk);
+    double sideLength = parser.value(length).toDouble(&lengthOk);
+    if (!samplesOk || samplesPerSide <= 0)
+    {
+        cerr << "--samples: expected a positive integer, not " << parser.value(samples).toStdString() << endl;
+        return 1;
+    }
+    if (!lengthOk || !std::isfinite(sideLength) || sideLength <= 0)
+    {
+        cerr << "--length: expected a positive number, not " << parser.value(length).toStdString() << endl;
+        return 1;
+    }
+
     QSurfaceFormat fmt;
     fmt.setVersion(3,3);
     fmt.setProfile(QSurfaceFormat::CoreProfile);
     QSurfaceFormat::setDefaultFormat(fmt);
 
     Window window;
+    window.setDomain(samplesPerSide, sideLength);
     window.resize(window.sizeHint());
     window.show();
 
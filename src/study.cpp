@@ -0,0 +1,243 @@
+#include "study.h"
+#include "data.h"
+
+#include <map>
+#include <sstream>
+#include <iomanip>
+
+
+vector<StudyPoint> studyGrid(const vector<string>& equations, const vector<double>& xCens, const vector<double>& yCens,
+                             const vector<double>& angles, const vector<double>& speeds, const vector<double>& precisions)
+{
+    vector<StudyPoint> points;
+    for (const string& equation : equations)
+        for (double xCen : xCens)
+            for (double yCen : yCens)
+                for (double angle : angles)
+                    for (double speed : speeds)
+                        for (double precision : precisions)
+                        {
+                            StudyPoint point;
+                            point.equation = equation;
+                            point.packet.xCen = xCen;
+                            point.packet.yCen = yCen;
+                            point.packet.angle = angle;
+                            point.packet.speed = speed;
+                            point.packet.precision = precision;
+                            points.push_back(point);
+                        }
+
+    return points;
+}
+
+
+string parseValueList(const string& text, vector<double>& values)
+{
+    // a range: the values are start + i*step, rather than accumulated, so that rounding does not add up
+    if (text.find(':') != string::npos)
+    {
+        double start, end, step;
+        char colon1, colon2;
+        istringstream in(text);
+        if (!(in >> start >> colon1 >> end >> colon2 >> step) || colon1 != ':' || colon2 != ':' || !(in >> ws).eof())
+            return "expected start:end:step, got \"" + text + "\"";
+        if (step <= 0 || end < start)
+            return "the range \"" + text + "\" is empty, the step must be positive and end at least start";
+
+        int count = int(floor((end - start)/step + EPSILON)) + 1;
+        for (int i = 0; i < count; ++i)
+            values.push_back(start + i*step);
+        return "";
+    }
+
+    istringstream in(text);
+    string item;
+    while (getline(in, item, ','))
+    {
+        istringstream itemIn(item);
+        double value;
+        if (!(itemIn >> value) || !(itemIn >> ws).eof())
+            return "\"" + item + "\" is not a number";
+        values.push_back(value);
+    }
+
+    if (values.empty())
+        return "no values given";
+    return "";
+}
+
+
+// the samples in [start, end] (world coordinates) along an axis of n of them, centered on the origin and length wide
+// first > last if there are none
+static void sampleRange(double start, double end, int n, double length, int& first, int& last)
+{
+    double spacing = length/(n - 1);
+    double from = min(max((start + length/2)/spacing, -1.0), double(n));
+    double to = min(max((end + length/2)/spacing, -1.0), double(n));
+    first = max(0, int(ceil(from - EPSILON)));
+    last = min(n - 1, int(floor(to + EPSILON)));
+}
+
+
+// probability(x1, x2, y1, y2) is that of Data, of one packet of a PacketBatch or of a DomainDecomposition
+// (all of them take inclusive sample indices)
+template <typename Probability>
+static void measure(StudyResult& result, const StudySettings& settings, Data& data, Probability probability)
+{
+    int nx = int(data.getSamplesX()), ny = int(data.getSamplesY());
+    int x1, x2, y1, y2, t1, t2;
+    sampleRange(settings.netXStart, settings.netXEnd, nx, data.getSideLengthX(), x1, x2);
+    sampleRange(settings.netYStart, settings.netYEnd, ny, data.getSideLengthY(), y1, y2);
+    sampleRange(settings.transmissionX, numeric_limits<double>::max(), nx, data.getSideLengthX(), t1, t2);
+
+    result.norm = probability(0, nx - 1, 0, ny - 1);
+    result.nettedProbability = (x1 <= x2 && y1 <= y2) ? probability(x1, x2, y1, y2) : 0.0;
+    result.transmission = (t1 <= t2) ? probability(t1, t2, 0, ny - 1) : 0.0;
+}
+
+
+vector<StudyResult> runStudy(const vector<StudyPoint>& points, const StudySettings& settings,
+                             const function<void(int)>& progress)
+{
+    vector<StudyResult> results(points.size());
+    int done = 0;
+    auto report = [&](int count)
+    {
+        done += count;
+        if (progress)
+            progress(done);
+    };
+
+    // the points of each equation, in the order the equations first appear in
+    vector<string> equations;
+    map<string, vector<int>> members;
+    for (int i = 0; i < int(points.size()); ++i)
+    {
+        results[i].point = points[i];
+        results[i].point.packet = clipPacket(points[i].packet);
+        if (members.find(points[i].equation) == members.end())
+            equations.push_back(points[i].equation);
+        members[points[i].equation].push_back(i);
+    }
+
+    // what PacketBatch and DomainDecomposition support, the decomposition wins: it is there for the large grids
+    bool plain = settings.backend == CPU_BACKEND && (settings.integrator == VERLET || settings.integrator == PEFRL) &&
+                 settings.absorbingWidth <= 0;
+    bool decomposed = plain && settings.ranks > 1;
+    bool batched = plain && !decomposed && settings.batched;
+
+    for (const string& equation : equations)
+    {
+        const vector<int>& indices = members[equation];
+
+        Data data;
+        data.setStencilOrder(settings.stencilOrder);
+        data.setDomain(settings.samplesX, settings.samplesY, settings.sideLengthX);
+        data.setIntegrator(settings.integrator);
+        data.setSimSpeed(settings.simSpeed);
+        data.setComputeBackend(settings.backend);   // the CPU, if there is no device after all
+        if (settings.absorbingWidth > 0)
+            data.setAbsorbingLayer(settings.absorbingWidth);
+
+        string message = data.setEquation(QString::fromStdString(equation));
+        if (message != "all is well" && message != "Values were clipped for stability")
+        {
+            for (int i : indices)
+                results[i].error = message;
+            report(int(indices.size()));
+            continue;
+        }
+
+        if (decomposed)
+        {
+            for (int i : indices)
+            {
+                data.setPacket(results[i].point.packet);
+                unique_ptr<DomainDecomposition> decomposition = data.createDecomposition(settings.ranks);
+                data.advanceDecomposition(*decomposition, settings.numFrames);
+
+                measure(results[i], settings, data, [&](int x1, int x2, int y1, int y2)
+                {
+                    return decomposition->getProbability(x1, x2, y1, y2);
+                });
+                report(1);
+            }
+        }
+        else if (batched)
+        {
+            for (size_t first = 0; first < indices.size(); first += STUDY_BATCH_SIZE)
+            {
+                size_t last = min(indices.size(), first + STUDY_BATCH_SIZE);
+                vector<Packet> packets;
+                for (size_t k = first; k < last; ++k)
+                    packets.push_back(results[indices[k]].point.packet);
+
+                PacketBatch batch = data.createBatch(packets);
+                data.advanceBatch(batch, settings.numFrames);
+
+                for (size_t k = first; k < last; ++k)
+                {
+                    int b = int(k - first);
+                    measure(results[indices[k]], settings, data, [&](int x1, int x2, int y1, int y2)
+                    {
+                        return batch.getProbability(b, x1, x2, y1, y2);
+                    });
+                }
+                report(int(last - first));
+            }
+        }
+        else
+        {
+            for (int i : indices)
+            {
+                data.setPacket(results[i].point.packet);
+                for (int frame = 0; frame < settings.numFrames; ++frame)
+                    data.advanceSimulation();
+
+                measure(results[i], settings, data, [&](int x1, int x2, int y1, int y2)
+                {
+                    return data.getProbability(x1, x2, y1, y2);
+                });
+                report(1);
+            }
+        }
+    }
+
+    return results;
+}
+
+
+// CSV field: quoted, with the quotes inside doubled
+static string quoted(const string& text)
+{
+    string field = "\"";
+    for (char c : text)
+    {
+        if (c == '"')
+            field += '"';
+        field += c;
+    }
+    return field + "\"";
+}
+
+
+void writeStudyTable(ostream& out, const vector<StudyResult>& results)
+{
+    out << "equation,xCen,yCen,angle,speed,precision,netted,norm,transmission,error\n";
+
+    ostringstream line;
+    line << setprecision(12);
+    for (const StudyResult& result : results)
+    {
+        const Packet& packet = result.point.packet;
+        line.str("");
+        line << quoted(result.point.equation) << ',' << packet.xCen << ',' << packet.yCen << ',' << packet.angle << ','
+             << packet.speed << ',' << packet.precision << ',';
+        if (result.error.empty())
+            line << result.nettedProbability << ',' << result.norm << ',' << result.transmission << ",";
+        else
+            line << ",,," << quoted(result.error);
+        out << line.str() << '\n';
+    }
+    out.flush();
+}
@@ -0,0 +1,269 @@
+#include "threadpool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// number of polls before a worker goes to sleep (or the caller blocks) : sweeps of a time step follow each other
+// within microseconds, much less than it takes to wake a sleeping thread
+#define SPIN_ITERATIONS 20000
+
+
+// the calling thread is moved to the index-th core of those it may run on (wrapping around), if there is such a thing
+// consecutive workers get consecutive cores: those usually share a socket, as do their (neighbouring) blocks of rows
+static bool pinToCore(int index)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return false;
+
+    int target = index%CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+        {
+            cpu_set_t single;
+            CPU_ZERO(&single);
+            CPU_SET(cpu, &single);
+            return pthread_setaffinity_np(pthread_self(), sizeof(single), &single) == 0;
+        }
+#endif
+    return false;
+}
+
+
+ThreadPool::ThreadPool(int numThreads, bool pin) : generation(0), remaining(0)
+{
+    const char* env = getenv("QUTOSS_THREADS");
+    if (numThreads <= 0 && env != NULL)
+        numThreads = atoi(env);
+    if (numThreads <= 0)
+        numThreads = int(thread::hardware_concurrency());
+    if (numThreads <= 0)
+        numThreads = 1;
+
+    const char* pinEnv = getenv("QUTOSS_PIN_THREADS");
+    if (pinEnv != NULL && strcmp(pinEnv, "0") != 0)
+        pin = true;
+#ifdef __linux__
+    pinned = pin;
+#endif
+
+    for (int i = 0; i < numThreads; ++i)
+        queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+    regionBarrier.reset(numThreads);
+
+    // the calling thread is worker 0
+    for (int i = 1; i < numThreads; ++i)
+        threads.push_back(thread(&ThreadPool::workerLoop, this, i));
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(jobLock);
+        stopping = true;
+        ++generation;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
+
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+
+void ThreadPool::parallelFor(int numTasks, const function<void(int)>& task)
+{
+    if (numTasks <= 0)
+        return;
+
+    // not worth waking anybody up for
+    if (numTasks == 1 || size() == 1)
+    {
+        for (int i = 0; i < numTasks; ++i)
+            task(i);
+        return;
+    }
+
+    lock_guard<mutex> callerGuard(callerLock);
+
+    // the job and counter must be in place before any task becomes visible:
+    // a worker that is late from the previous job could already pick these up
+    job = &task;
+    remaining.store(numTasks);
+
+    // deal out contiguous chunks, so that neighbouring tasks (rows) tend to stay on the same thread
+    int numQueues = size();
+    for (int q = 0; q < numQueues; ++q)
+    {
+        int start, end;
+        ownedRange(q, numTasks, start, end);
+        lock_guard<mutex> guard(queues[q]->lock);
+        for (int i = start; i < end; ++i)
+            queues[q]->tasks.push_back(i);
+    }
+
+    {
+        lock_guard<mutex> guard(jobLock);
+        ++generation;
+    }
+    wake.notify_all();
+
+    runTasks(0);
+
+    // barrier: wait for tasks that were taken by other workers
+    for (int spin = 0; spin < SPIN_ITERATIONS && remaining.load() > 0; ++spin)
+        this_thread::yield();
+    if (remaining.load() > 0)
+    {
+        unique_lock<mutex> lock(jobLock);
+        finished.wait(lock, [this] { return remaining.load() == 0; });
+    }
+}
+
+
+void ThreadPool::runRegion(const function<void(int, int)>& body)
+{
+    if (size() == 1)
+    {
+        body(0, 1);
+        return;
+    }
+
+    lock_guard<mutex> callerGuard(callerLock);
+    remaining.store(size());
+
+    {
+        lock_guard<mutex> guard(jobLock);
+        region = &body;
+        ++generation;
+    }
+    wake.notify_all();
+
+    body(0, size());
+    finishTask();
+
+    // every worker has to take part, so unlike parallelFor there is no way around waiting for all of them
+    for (int spin = 0; spin < SPIN_ITERATIONS && remaining.load() > 0; ++spin)
+        this_thread::yield();
+
+    unique_lock<mutex> lock(jobLock);
+    finished.wait(lock, [this] { return remaining.load() == 0; });
+    region = nullptr;
+}
+
+
+void ThreadPool::workerLoop(int id)
+{
+    unsigned long seen = 0;
+    if (pinned)
+        pinToCore(id);
+
+    while (true)
+    {
+        // poll for a while before going to sleep
+        for (int spin = 0; spin < SPIN_ITERATIONS && generation.load() == seen; ++spin)
+            this_thread::yield();
+
+        const function<void(int, int)>* body;
+        {
+            unique_lock<mutex> lock(jobLock);
+            wake.wait(lock, [&] { return generation.load() != seen; });
+            if (stopping)
+                return;
+            seen = generation.load();
+            body = region;
+        }
+
+        if (body != nullptr)
+        {
+            (*body)(id, size());
+            finishTask();
+        }
+        else
+            runTasks(id);
+    }
+}
+
+
+void ThreadPool::runTasks(int id)
+{
+    int task;
+    while (popTask(id, task))
+    {
+        (*job)(task);
+        finishTask();
+    }
+}
+
+
+void ThreadPool::finishTask()
+{
+    if (remaining.fetch_sub(1) == 1)
+    {
+        // last one out: the caller may be asleep
+        lock_guard<mutex> guard(jobLock);
+        finished.notify_all();
+    }
+}
+
+
+bool ThreadPool::popTask(int id, int& task)
+{
+    // own tasks, from the front
+    {
+        TaskQueue& own = *queues[id];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of someone else's
+    int numQueues = size();
+    for (int i = 1; i < numQueues; ++i)
+    {
+        TaskQueue& victim = *queues[(id + i)%numQueues];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void SpinBarrier::wait()
+{
+    unsigned current = phase.load();
+
+    // the last thread to arrive releases everybody else
+    if (waiting.fetch_add(1) + 1 == count)
+    {
+        waiting.store(0);
+        phase.fetch_add(1);
+        return;
+    }
+
+    while (phase.load() == current)
+        this_thread::yield();
+}